@@ -1,9 +1,12 @@
+#include <stdio.h>
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <ctype.h>
 
 #include "args.h"
+#include "trace.h"
 
 struct option longopts[] = {
 	{"help", no_argument, NULL, '?'},
@@ -14,6 +17,14 @@ struct option longopts[] = {
 	{"input", required_argument, NULL, 'i'},
 	{"color", required_argument, NULL, 'c'},
 	{"intersects", no_argument, NULL, 'x'},
+	{"render", required_argument, NULL, 11},
+	{"size", required_argument, NULL, 12},
+	{"file", required_argument, NULL, 13},
+	{"format", required_argument, NULL, 14},
+	{"serve", required_argument, NULL, 15},
+	{"stats", no_argument, NULL, 16},
+	{"trace", required_argument, NULL, 17},
+	{"compile", no_argument, NULL, 18},
 	{0}
 };
 
@@ -24,11 +35,29 @@ const char help_msg[] =
 	"\n"
 	"    -i, --input=EQUATION     Add an equation for a curve\n"
 	"    -c, --color=COLOR        Set the color of the curve specified before (def: red)\n"
+	"        --file=PATH          Add the equations on each line of PATH (- for stdin)\n"
 	"    -e, --center=XPOS,YPOS   Position of the center of the grid (def: 0,0)\n"
 	"    -h, --height=UNITS       Height of grid as float (def: 10)\n"
 	"    -w, --width=UNITS        Width of grid as float (def: 10)\n"
 	"    -x, --intersects         Only calculate and print the intersections\n"
 	"                             of the given curves\n"
+	"        --format=FORMAT      Print intersections as text, csv, jsonl, or binary\n"
+	"                             records (def: text)\n"
+	"        --render=FILE        Render the graph to an image without starting\n"
+	"                             ncurses. PNG if FILE ends in .png else PPM\n"
+	"        --size=WIDTHxHEIGHT  Size in pixels of rendered image (def: 1000x1000)\n"
+	"        --serve=SOCKET       Serve plot and intersection queries over the Unix\n"
+	"                             socket at SOCKET without starting ncurses\n"
+	"        --stats              Print evaluation counts and the time spent drawing\n"
+	"                             each curve to stderr at exit\n"
+	"        --trace=FILE         Record when equations are parsed, curves drawn,\n"
+	"                             and intersections found to FILE as trace-event\n"
+	"                             JSON for chrome://tracing or Perfetto. Only\n"
+	"                             equations given after it have their parsing traced\n"
+	"        --compile            Compile the equations to native code with the C\n"
+	"                             compiler ($CC or cc) and cache the objects in\n"
+	"                             ~/.cache/skedia. Equations edited afterwards are\n"
+	"                             compiled again\n"
 	"    -?, --help               Give this help list\n"
 	"        --usage              Give a short usage message\n"
 	"\n"
@@ -46,6 +75,8 @@ const char help_msg[] =
 	"    c or C - Clear all Intersections\n"
 	"    , or < - Move to prior Intersection\n"
 	"    . or > - Move to next Intersection\n"
+	"    m or M - Cycle between curve renderers (scanning, tracing, braille)\n"
+	"    s or S - Show or hide statistics of each redraw\n"
 	"    Control-A (^A) - Switch to Gallery Mode and Create new textbox\n"
 	"    g or G - Switch to Gallery Mode\n"
 	"    Control-C (^C) or Control-Z (^Z) or q or Q - Exit\n"
@@ -67,13 +98,17 @@ const char help_msg[] =
 // Usage message
 const char usage_msg[] = 
 	"Usage: skedia [-? | --help] [-w WIDTH] [-h HEIGHT] [-e XPOS,YPOS]\n"
-	"              [-x | --intersects] [-i EQU1 [-c COL1] [-i EQU2 ...]]\n"
+	"              [-x | --intersects [--format FORMAT]]\n"
+	"              [--render FILE [--size WIDTHxHEIGHT]] [--serve SOCKET]\n"
+	"              [--stats] [--trace FILE] [--compile] [--file PATH]\n"
+	"              [-i EQU1 [-c COL1] [-i EQU2 ...]]\n"
 ;
 
 
 
-// Forward declaration
+// Forward declarations
 static int handle_arg(int key, char *arg, struct args_s *prms);
+static bool load_file(equat_t *gallery, FILE *fp);
 
 // Parse list of command line arguments using getopt
 void parse_args(struct args_s *args, int argc, char *argv[]){
@@ -161,16 +196,62 @@ static int handle_arg(int key, char *arg, struct args_s *prms){
 			if(parse_equat(*(prms->gallery), tmp) != ERR_OK){
 				// If there is an error while parsing return it
 				fprintf(stderr, "Error %s while reading equation: %s\n", parse_errstr[(tmp)->err], arg);
-				// If expressions were created during parsing deallocate them
-				if(!(tmp->is_variable) && tmp->left) free_expr(tmp->left);
-				if(tmp->right) free_expr(tmp->right);
-				free(tmp);
+				// Remove the equation from the gallery and deallocate it
+				remove_equat(prms->gallery, tmp);
 				
 				iserr = 1;
 			}
 		break;
+		// Add every equation of a file
+		case 13:
+		{
+			FILE *fp = strcmp(arg, "-") == 0 ? stdin : fopen(arg, "r");
+			if(!fp){
+				fprintf(stderr, "Unable to open file: %s\n", arg);
+				iserr = 1;
+				break;
+			}
+			
+			iserr = !load_file(prms->gallery, fp);
+			if(fp != stdin) fclose(fp);
+		}
+		break;
 		case 'x': prms->only_intersects = 1;
 		break;
+		case 14:
+			for(key = 0; key < FORMAT_COUNT && strcmp(arg, format_names[key]) != 0; key++){}
+			if(key < FORMAT_COUNT) prms->format = key;
+			else iserr = 1;
+		break;
+		
+		// Render image instead of starting ncurses
+		case 11: prms->render_path = arg;
+		break;
+		case 12:
+			if(sscanf(arg, "%dx%d", &(prms->render_wid), &(prms->render_hei)) != 2
+			|| prms->render_wid <= 0 || prms->render_hei <= 0
+			) iserr = 1;
+		break;
+		
+		// Serve queries over a socket instead of starting ncurses
+		case 15: prms->serve_path = arg;
+		break;
+		
+		// Report statistics at exit
+		case 16: prms->show_stats = 1;
+		break;
+		
+		// Start tracing immediately so the equations given after are traced
+		case 17:
+			if(!trace_start(arg)){
+				fprintf(stderr, "Unable to open trace file: %s\n", arg);
+				iserr = 1;
+			}
+		break;
+		
+		// Compile the equations once all of them are given
+		case 18: prms->compile = 1;
+		break;
 		
 		// Error if unknown option encountered
 		default: iserr = 1;
@@ -186,3 +267,46 @@ static int handle_arg(int key, char *arg, struct args_s *prms){
 	return -1;
 }
 
+// Add the equation on each line of fp to the end of gallery
+// Blank lines and lines starting with '#' are skipped
+// Returns false if an equation could not be parsed
+static bool load_file(equat_t *gallery, FILE *fp){
+	// Seek to the end of the gallery once so each equation is appended in constant time
+	equat_t tail = *gallery, first = NULL;
+	while(tail && tail->next) tail = tail->next;
+	
+	bool ok = 1;
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	while((len = getline(&line, &cap, fp)) != -1){
+		// Remove line ending
+		while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+		
+		char *s = line;
+		while(isspace(*s)) s++;
+		if(*s == '\0' || *s == '#') continue;
+		
+		equat_t eq = append_equat(gallery, tail, line);
+		if(!eq){
+			fprintf(stderr, "Unable to allocate equation: %s\n", line);
+			ok = 0;
+			break;
+		}
+		tail = eq;
+		if(!first) first = eq;
+	}
+	free(line);
+	if(!first) return ok;
+	
+	// Parse the equations together so they may reference variables defined on later lines
+	parse_equats(*gallery, first);
+	
+	for(equat_t eq = first; eq; eq = eq->next){
+		if(eq->err != ERR_OK){
+			fprintf(stderr, "Error %s while reading equation: %s\n", parse_errstr[eq->err], eq->text);
+			ok = 0;
+		}
+	}
+	return ok;
+}
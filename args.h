@@ -3,17 +3,36 @@
 
 #include "graph.h"
 #include "gallery.h"
+#include "output.h"
 
 struct args_s {
 	// Indicate that the program should not start ncurses
 	// And simply print the calculated intersections
 	bool only_intersects;
+	// Format the intersections are printed in
+	format_t format;
 	
 	// Store location and size of graph in terminal and in the plane
 	graph_t *grp;
 	
 	// Linked list of equations representing the gallery
 	equat_t *gallery;
+	
+	// File to render an image of the graph to instead of starting ncurses
+	// NULL if no image should be rendered
+	const char *render_path;
+	// Dimensions of the rendered image in pixels
+	int render_wid, render_hei;
+	
+	// Unix socket to serve queries on instead of starting ncurses
+	// NULL if the program shouldn't serve
+	const char *serve_path;
+	
+	// Print the statistics counted while running to stderr at exit
+	bool show_stats;
+	
+	// Compile the equations to native code before drawing or searching them (see compile.h)
+	bool compile;
 };
 
 // Parse list of command line arguments using getopt
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gallery.h"
+#include "graph.h"
+#include "intersect.h"
+#include "signgrid.h"
+
+// Flags the benchmarks were compiled with (set by the makefile)
+#ifndef BENCH_FLAGS
+#define BENCH_FLAGS ""
+#endif
+
+// Default least number of seconds each measurement is repeated for
+#define BENCH_MIN_TIME 0.2
+// Region of the plane every benchmark is run on
+#define BENCH_X -5
+#define BENCH_Y 5
+#define BENCH_SIZE 10
+// Points per side of the grid evaluated by the eval benchmark
+#define BENCH_EVAL_SIDE 128
+// Cells per side of the lattice searched by the intersection benchmark
+#define BENCH_INTERS_SIDE 200
+// Number of variables chained together by the variables corpus
+#define BENCH_VAR_COUNT 40
+
+// Fixed set of galleries that every benchmark is run on
+struct corpus_s{
+	const char *name;
+	// Null terminated equations
+	const char *eqs[16];
+};
+
+static const struct corpus_s corpora[] = {
+	{"polynomial", {
+		"x^3 - 3*x*y^2 = 1",
+		"x^4 + y^4 - 4*x^2*y^2 = 2",
+		"y^2 = x^3 - 2*x + 1",
+		"x^5 - y^5 + x*y = 0.5",
+		NULL
+	}},
+	{"trig", {
+		"sin(x*y) = cos(x + y)",
+		"sin(x)^2 + cos(3*y) = tan(x*y) / 10",
+		"sin(sin(x) + cos(y)) = cos(x*y) / 2",
+		"sin(x^2 + y^2) = 0",
+		NULL
+	}},
+	{"nested", {
+		"f1(a) := sin(a) + a / 2",
+		"f2(a) := f1(f1(a)) - a / 3",
+		"f3(a) := f2(f2(a)) + f1(a)",
+		"f4(a) := f3(f3(a)) / 2",
+		"f4(x) + f3(y) = 1",
+		"f4(x) = y",
+		"f2(x * y) = f3(x) - f1(y)",
+		NULL
+	}},
+	// The variables are generated by corpus_texts
+	{"variables", {
+		"v39 = y",
+		"v20 * v39 = 1",
+		"v39 - v10 = x^2 - y",
+		NULL
+	}}
+};
+#define CORPUS_COUNT (sizeof(corpora) / sizeof(corpora[0]))
+
+// Canvas sizes in cells that the drawing benchmarks are run at
+static const int canvases[][2] = {{80, 24}, {200, 60}, {400, 200}};
+#define CANVAS_COUNT (sizeof(canvases) / sizeof(canvases[0]))
+static const char *renderer_names[RENDER_COUNT] = {"scan", "trace", "braille"};
+
+// Least number of seconds each measurement is repeated for
+static double min_time = BENCH_MIN_TIME;
+// Whether a result was written yet (to separate them with commas)
+static bool wrote_result = 0;
+
+
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Repeat fn(inp) until it has run for at least min_time seconds
+ *
+ * Arguments:
+ *   void (*fn)(void*) : Function to measure
+ *   void *inp : Parameters passed to fn
+ *   long *iters : Set to the number of times fn was run
+ *
+ * Returns:
+ *   double : Average number of seconds each run took
+ */
+static double measure(void (*fn)(void*), void *inp, long *iters){
+	long n = 0;
+	double start = now(), elapsed;
+	do{
+		fn(inp);
+		n++;
+		elapsed = now() - start;
+	}while(elapsed < min_time);
+	
+	*iters = n;
+	return elapsed / n;
+}
+
+// Write one result as a JSON object in the results array
+static void write_result(const char *corpus, const char *bench, double value, const char *unit, long iters){
+	printf("%s\n    {\"corpus\": \"%s\", \"benchmark\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", \"iterations\": %ld}",
+		wrote_result ? "," : "", corpus, bench, value, unit, iters
+	);
+	wrote_result = 1;
+	fflush(stdout);
+}
+
+
+
+// Equations of a corpus and the gallery made from them
+struct load_s{
+	const char **texts;
+	int count;
+	size_t bytes;
+	equat_t gallery;
+};
+
+// Texts of the equations of corpus c with any generated ones first
+// The returned array and any generated texts must be freed by free_texts
+static const char **corpus_texts(const struct corpus_s *c, int *count, int *generated){
+	int fixed = 0;
+	while(c->eqs[fixed]) fixed++;
+	*generated = strcmp(c->name, "variables") == 0 ? BENCH_VAR_COUNT : 0;
+	*count = *generated + fixed;
+	
+	const char **texts = malloc(*count * sizeof(char*));
+	for(int i = 0; i < *generated; i++){
+		// Each variable depends on the last so evaluating one evaluates the whole chain
+		char *buf = malloc(96);
+		if(i == 0) snprintf(buf, 96, "v0 := x + y / 2");
+		else snprintf(buf, 96, "v%d := v%d * 0.9 + sin(x * %d / 10) + y / %d", i, i - 1, i, i + 1);
+		texts[i] = buf;
+	}
+	for(int i = 0; i < fixed; i++) texts[*generated + i] = c->eqs[i];
+	return texts;
+}
+
+static void free_texts(const char **texts, int generated){
+	for(int i = 0; i < generated; i++) free((char*)texts[i]);
+	free(texts);
+}
+
+// Add the equations of ld to its gallery and parse them together
+static void load_gallery(struct load_s *ld){
+	equat_t tail = NULL, first = NULL;
+	for(int i = 0; i < ld->count; i++){
+		tail = append_equat(&(ld->gallery), tail, ld->texts[i]);
+		if(!first) first = tail;
+	}
+	parse_equats(ld->gallery, first);
+}
+
+// Remove every equation from the gallery of ld
+static void clear_gallery(struct load_s *ld){
+	equat_t tail = ld->gallery;
+	while(tail && tail->next) tail = tail->next;
+	while(tail){
+		equat_t prev = tail->prev;
+		remove_equat(&(ld->gallery), tail);
+		tail = prev;
+	}
+}
+
+// Load and clear the gallery timing only the load
+static double parse_time;
+static void bench_parse(void *inp){
+	double start = now();
+	load_gallery(inp);
+	parse_time += now() - start;
+	clear_gallery(inp);
+}
+
+// Evaluate every curve at every point of a grid of the region
+struct eval_s{
+	equat_t *curves;
+	int count;
+	double sink;
+};
+static void bench_eval(void *inp){
+	struct eval_s *ev = inp;
+	double step = (double)BENCH_SIZE / BENCH_EVAL_SIDE, sum = 0;
+	for(int k = 0; k < ev->count; k++){
+		for(int i = 0; i < BENCH_EVAL_SIDE; i++){
+			for(int j = 0; j < BENCH_EVAL_SIDE; j++){
+				sum += eval_equat(ev->curves[k], BENCH_X + j * step, BENCH_Y - i * step);
+			}
+		}
+	}
+	// Keep the evaluations from being optimized out
+	ev->sink += sum;
+}
+
+// Target which only stores the color of each cell
+static void bench_put(target_t *tg, int x, int y, int ch, int color){
+	(void)ch;
+	if(x < 0 || x >= tg->cols || y < 0 || y >= tg->rows) return;
+	((unsigned char*)tg->data)[(size_t)y * tg->cols + x] = color;
+}
+
+// Draw the curves of a gallery onto a canvas
+struct draw_s{
+	graph_t gr;
+	equat_t gallery;
+	render_t renderer;
+	signgrid_t grid;
+};
+static void bench_draw(void *inp){
+	struct draw_s *dr = inp;
+	memset(dr->gr.tg->data, 0, (size_t)dr->gr.tg->cols * dr->gr.tg->rows);
+	draw_curves(dr->gr, dr->gallery, dr->renderer, &(dr->grid));
+}
+
+// Search every pair of curves using their sampled signs
+struct inters_s{
+	equat_t *curves;
+	int count;
+	struct bound_s rect;
+	signgrid_t grid;
+	long found;
+};
+static void bench_inters(void *inp){
+	struct inters_s *in = inp;
+	double prec = (double)BENCH_SIZE / 10000;
+	for(int i = 0; i < in->count; i++){
+		for(int j = i + 1; j < in->count; j++){
+			inter_t inters = NULL;
+			in->rect.signs1 = signgrid_plane(&(in->grid), i);
+			in->rect.signs2 = signgrid_plane(&(in->grid), j);
+			append_inters(&inters, in->rect, eval_equat, in->curves[i], eval_equat, in->curves[j], 30, prec);
+			if(inters){
+				inter_t inr = inters;
+				do{
+					in->found++;
+					inr = inr->next;
+				}while(inr != inters);
+				free_inters(inters);
+			}
+		}
+	}
+}
+
+
+
+// Run every benchmark on corpus c
+static void bench_corpus(const struct corpus_s *c){
+	int generated;
+	struct load_s ld = {0};
+	ld.texts = corpus_texts(c, &(ld.count), &generated);
+	for(int i = 0; i < ld.count; i++) ld.bytes += strlen(ld.texts[i]);
+	long iters;
+	
+	// Parsing
+	parse_time = 0;
+	measure(bench_parse, &ld, &iters);
+	write_result(c->name, "parse", ld.count * iters / parse_time, "equations/s", iters);
+	write_result(c->name, "parse_bytes", ld.bytes * iters / parse_time, "bytes/s", iters);
+	
+	// The rest work on the loaded gallery
+	load_gallery(&ld);
+	int count = 0;
+	for(equat_t eq = ld.gallery; eq; eq = eq->next) if(!(eq->is_variable) && eq->right) count++;
+	equat_t *curves = malloc((count > 0 ? count : 1) * sizeof(equat_t));
+	count = 0;
+	for(equat_t eq = ld.gallery; eq; eq = eq->next) if(!(eq->is_variable) && eq->right) curves[count++] = eq;
+	
+	// Evaluation
+	struct eval_s ev = {curves, count, 0};
+	double secs = measure(bench_eval, &ev, &iters);
+	write_result(c->name, "eval", (double)count * BENCH_EVAL_SIDE * BENCH_EVAL_SIDE / secs, "points/s", iters);
+	
+	// Drawing with each renderer at each canvas size
+	for(int r = 0; r < RENDER_COUNT; r++){
+		for(size_t k = 0; k < CANVAS_COUNT; k++){
+			target_t tg = {canvases[k][0], canvases[k][1], bench_put, NULL, NULL};
+			tg.data = malloc((size_t)tg.cols * tg.rows);
+			struct draw_s dr = {.gr = {&tg, BENCH_X, BENCH_Y, BENCH_SIZE, BENCH_SIZE}, .gallery = ld.gallery, .renderer = r};
+			
+			secs = measure(bench_draw, &dr, &iters);
+			char name[64];
+			snprintf(name, sizeof(name), "draw_%s_%dx%d", renderer_names[r], tg.cols, tg.rows);
+			write_result(c->name, name, 1 / secs, "frames/s", iters);
+			
+			signgrid_free(&(dr.grid));
+			free(tg.data);
+		}
+	}
+	
+	// Intersections of every pair from signs sampled beforehand
+	if(count > 1){
+		struct inters_s in = {.curves = curves, .count = count, .rect = {
+			.x = BENCH_X, .y = BENCH_Y, .width = BENCH_SIZE, .height = BENCH_SIZE, .rows = BENCH_INTERS_SIDE, .columns = BENCH_INTERS_SIDE
+		}};
+		sample_equats(&(in.grid), in.rect, curves, count);
+		secs = measure(bench_inters, &in, &iters);
+		write_result(c->name, "inters", 1e3 * secs / (count * (count - 1) / 2), "ms/pair", iters);
+		write_result(c->name, "inters_found", (double)in.found / iters, "intersections", iters);
+		signgrid_free(&(in.grid));
+	}
+	
+	free(curves);
+	clear_gallery(&ld);
+	free_texts(ld.texts, generated);
+}
+
+int main(int argc, char *argv[]){
+	// Optional least number of seconds per measurement and names of the corpora to run
+	int first = 1;
+	if(argc > 2 && strcmp(argv[1], "-t") == 0){
+		min_time = atof(argv[2]);
+		first = 3;
+	}
+	
+	printf("{\n  \"flags\": \"%s\",\n  \"min_time\": %g,\n  \"results\": [", BENCH_FLAGS, min_time);
+	for(size_t i = 0; i < CORPUS_COUNT; i++){
+		bool run = first >= argc;
+		for(int a = first; a < argc; a++) run |= strcmp(argv[a], corpora[i].name) == 0;
+		if(run) bench_corpus(&corpora[i]);
+	}
+	printf("\n  ]\n}\n");
+	return 0;
+}
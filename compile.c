@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+#include "compile.h"
+
+// Options the source is compiled with after the compiler
+// Errno isn't needed so the compiler may treat math functions as pure,
+// and contractions into fused multiply adds are disabled so results match the interpreter
+static const char compile_flags[] = "-O3 -fno-math-errno -ffp-contract=off -fPIC -shared";
+// Added to the options only when the CPU can be identified for the cache key
+// since the objects then use instructions other CPUs sharing the cache may lack
+static const char native_flag[] = "-march=native";
+
+// Lines of /proc/cpuinfo naming the model and instruction set extensions of the CPU (x86, Arm, and RISC-V)
+static const char *cpu_keys[] = {
+	"vendor_id", "cpu family", "model", "model name", "flags",
+	"CPU implementer", "CPU architecture", "CPU variant", "CPU part", "Features", "isa"
+};
+#define CPU_KEY_COUNT (sizeof(cpu_keys) / sizeof(cpu_keys[0]))
+
+// Directory the objects are cached in, created on first use
+static char cache_dir[4096];
+// Hash of the model and extensions of the CPU that native code is built for (see hash_cpu)
+static uint64_t cpu_hash;
+
+
+
+// Continue the 64 bit FNV-1a hash h over the n bytes of data
+static uint64_t hash_bytes(uint64_t h, const char *data, size_t n){
+	for(size_t i = 0; i < n; i++){
+		h ^= (unsigned char)data[i];
+		h *= 0x100000001b3;
+	}
+	return h;
+}
+
+// Hash the description of the first CPU in /proc/cpuinfo into cpu_hash the first time it is called
+// Returns whether any of it could be read
+static bool hash_cpu(void){
+	static bool read, found;
+	if(read) return found;
+	read = 1;
+	FILE *fp = fopen("/proc/cpuinfo", "r");
+	if(!fp) return 0;
+	
+	char line[4096];
+	cpu_hash = 0xcbf29ce484222325;
+	while(fgets(line, sizeof(line), fp)){
+		// The CPUs are separated by blank lines and share the instruction set
+		if(line[0] == '\n'){
+			if(found) break;
+			continue;
+		}
+		
+		// Key is padded with whitespace before the ':'
+		size_t n = strcspn(line, ":");
+		while(n > 0 && (line[n - 1] == ' ' || line[n - 1] == '\t')) n--;
+		for(size_t i = 0; i < CPU_KEY_COUNT; i++){
+			if(strlen(cpu_keys[i]) == n && strncmp(line, cpu_keys[i], n) == 0){
+				cpu_hash = hash_bytes(cpu_hash, line, strlen(line));
+				found = 1;
+			}
+		}
+	}
+	fclose(fp);
+	return found;
+}
+
+// Create dir unless it already exists
+static bool make_dir(const char *dir){
+	return mkdir(dir, 0700) == 0 || errno == EEXIST;
+}
+
+// Check that dir is a directory (and not a link to one) of the user which only they can access
+// so no one else can place objects in it to be loaded
+// Directories of the user open to others are narrowed
+static bool private_dir(const char *dir){
+	struct stat st;
+	if(lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid()) return 0;
+	return (st.st_mode & 0777) == 0700 || chmod(dir, 0700) == 0;
+}
+
+// Find and create the cache directory
+// Returns NULL if it could not be created or is not private to the user
+static const char *get_cache_dir(void){
+	if(cache_dir[0]) return cache_dir;
+	
+	const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+	int n;
+	if(xdg && *xdg){
+		n = snprintf(cache_dir, sizeof(cache_dir), "%s", xdg);
+	}else if(home && *home){
+		n = snprintf(cache_dir, sizeof(cache_dir), "%s/.cache", home);
+	}else{
+		n = snprintf(cache_dir, sizeof(cache_dir), "/tmp");
+	}
+	if(n < 0 || n + 32 >= (int)sizeof(cache_dir) || !make_dir(cache_dir)){
+		cache_dir[0] = '\0';
+		return NULL;
+	}
+	
+	// Directories in /tmp are named by the user so each user can have one
+	if(!(xdg && *xdg) && !(home && *home)) sprintf(cache_dir + n, "/skedia-%u", (unsigned)getuid());
+	else strcat(cache_dir, "/skedia");
+	// Paths are single quoted in the compiler command
+	if(!make_dir(cache_dir) || !private_dir(cache_dir) || strchr(cache_dir, '\'')){
+		cache_dir[0] = '\0';
+		return NULL;
+	}
+	return cache_dir;
+}
+
+
+
+// Write the functions of the memoized variables and functions collected in ctx while writing the equation
+// Writing each of them may collect more so this continues until all of them are written
+static bool write_refs(FILE *fp, expr_emit_t *ctx){
+	int m = 0, f = 0;
+	while(m < ctx->memo_count || f < ctx->ref_count){
+		if(m < ctx->memo_count){
+			if(!(ctx->memos[m]->ref)) return 0;
+			fprintf(fp, "static double m%d(double x, double y, double r){\n\treturn ", m);
+			if(!expr_emit(fp, ctx->memos[m]->ref, ctx)) return 0;
+			m++;
+		}else{
+			fprintf(fp, "static double f%d(double x, double y, double r, const double *a){\n\treturn ", f);
+			if(!expr_emit(fp, ctx->refs[f], ctx)) return 0;
+			f++;
+		}
+		fprintf(fp, ";\n}\n\n");
+	}
+	return 1;
+}
+
+// Write the C source of eq into a buffer allocated in *source
+// The builtins it calls through pointers are collected into funcs
+// Returns the number of those builtins or -1 if eq can't be written as C
+static int write_source(equat_t eq, char **source, union expr_func_u *funcs){
+	double *caches[] = {equat_param('x'), equat_param('y'), equat_param('r')};
+	const char *names[] = {"x", "y", "r"};
+	expr_memo_t *memos[COMPILE_MAX_REFS];
+	expr_t refs[COMPILE_MAX_REFS];
+	expr_emit_t ctx = {
+		caches, names, 3,
+		funcs, 0, COMPILE_MAX_FUNCS,
+		memos, 0, COMPILE_MAX_REFS,
+		refs, 0, COMPILE_MAX_REFS
+	};
+	
+	// Write the body first since the declarations depend on what it references
+	char *body;
+	size_t body_len;
+	FILE *fp = open_memstream(&body, &body_len);
+	if(!fp) return -1;
+	
+	fprintf(fp, "static inline double point(double x, double y){\n\tdouble r = hypot(x, y);\n\treturn ");
+	bool ok = expr_emit(fp, eq->left, &ctx);
+	fprintf(fp, " - ");
+	ok = ok && expr_emit(fp, eq->right, &ctx);
+	fprintf(fp, ";\n}\n\n");
+	ok = ok && write_refs(fp, &ctx);
+	fclose(fp);
+	if(!ok){
+		free(body);
+		return -1;
+	}
+	
+	fp = open_memstream(source, &body_len);
+	if(!fp){
+		free(body);
+		return -1;
+	}
+	// The text of the equation is left out so equations differing only in spacing share an object
+	fprintf(fp, "// Generated by skedia\n#include <math.h>\n\n");
+	fprintf(fp, "static void *fn[%d];\n", ctx.func_count > 0 ? ctx.func_count : 1);
+	for(int i = 0; i < ctx.memo_count; i++){
+		fprintf(fp, "static double m%d(double x, double y, double r) __attribute__((pure));\n", i);
+	}
+	for(int i = 0; i < ctx.ref_count; i++){
+		fprintf(fp, "static double f%d(double x, double y, double r, const double *a) __attribute__((pure));\n", i);
+	}
+	fprintf(fp, "\n%s", body);
+	
+	// Exported entry points
+	fprintf(fp,
+		"void skedia_init(void *const *funcs){\n"
+		"\tfor(int i = 0; i < %d; i++) fn[i] = funcs[i];\n"
+		"}\n\n"
+		"double skedia_point(double x, double y){\n"
+		"\treturn point(x, y);\n"
+		"}\n\n"
+		"void skedia_row(const double *restrict xs, double y, double *restrict out, int n){\n"
+		"\tfor(int i = 0; i < n; i++) out[i] = point(xs[i], y);\n"
+		"}\n",
+		ctx.func_count
+	);
+	fclose(fp);
+	free(body);
+	return ctx.func_count;
+}
+
+// Compile the source into the shared object base.so keeping the source in base.c
+// The code is only tuned for the CPU it runs on if native is set
+static bool run_compiler(const char *source, const char *base, bool native){
+	const char *cc = getenv("CC");
+	if(!cc || !*cc) cc = "cc";
+	
+	// Compile next to the final path and rename so concurrent runs never load a partial object
+	char src_path[4200], tmp_path[4200], path[4200], cmd[13000];
+	snprintf(src_path, sizeof(src_path), "%.4090s.c", base);
+	snprintf(tmp_path, sizeof(tmp_path), "%.4090s.so.%ld", base, (long)getpid());
+	snprintf(path, sizeof(path), "%.4090s.so", base);
+	
+	FILE *fp = fopen(src_path, "w");
+	if(!fp) return 0;
+	fputs(source, fp);
+	if(fclose(fp) != 0) return 0;
+	
+	snprintf(cmd, sizeof(cmd), "%s %s %s -o '%s' '%s' -lm", cc, compile_flags, native ? native_flag : "", tmp_path, src_path);
+	if(system(cmd) != 0 || rename(tmp_path, path) != 0){
+		unlink(tmp_path);
+		return 0;
+	}
+	return 1;
+}
+
+// Compile eq as compile_equat does without recording a failure
+static bool compile_native(equat_t eq){
+	drop_native(eq);
+	if(eq->is_variable || !(eq->left) || !(eq->right) || eq->err != ERR_OK) return 0;
+	
+	char *source;
+	union expr_func_u funcs[COMPILE_MAX_FUNCS];
+	int func_count = write_source(eq, &source, funcs);
+	if(func_count < 0) return 0;
+	
+	// Objects are named by the hash of everything that affects their code
+	const char *cc = getenv("CC");
+	uint64_t h = 0xcbf29ce484222325;
+	h = hash_bytes(h, source, strlen(source));
+	h = hash_bytes(h, compile_flags, sizeof(compile_flags));
+	if(cc) h = hash_bytes(h, cc, strlen(cc));
+	bool native = hash_cpu();
+	if(native){
+		h = hash_bytes(h, native_flag, sizeof(native_flag));
+		h = hash_bytes(h, (const char*)&cpu_hash, sizeof(cpu_hash));
+	}
+	
+	// Without a private cache the object is built in a new directory which is removed once it is loaded
+	const char *dir = get_cache_dir();
+	char tmp_dir[] = "/tmp/skedia-XXXXXX";
+	bool cached = dir != NULL;
+	if(!cached) dir = mkdtemp(tmp_dir);
+	
+	char base[4200], path[4200];
+	if(dir){
+		snprintf(base, sizeof(base), "%s/%016llx", dir, (unsigned long long)h);
+		snprintf(path, sizeof(path), "%.4090s.so", base);
+	}
+	bool ok = dir && ((cached && access(path, R_OK) == 0) || run_compiler(source, base, native));
+	free(source);
+	
+	void *handle = ok ? dlopen(path, RTLD_NOW | RTLD_LOCAL) : NULL;
+	if(!cached && dir){
+		char src_path[4200];
+		snprintf(src_path, sizeof(src_path), "%.4090s.c", base);
+		unlink(src_path);
+		unlink(path);
+		rmdir(dir);
+	}
+	if(!handle) return 0;
+	
+	void (*init)(void *const*) = (void (*)(void *const*))dlsym(handle, "skedia_init");
+	double (*point)(double, double) = (double (*)(double, double))dlsym(handle, "skedia_point");
+	void (*row)(const double*, double, double*, int) = (void (*)(const double*, double, double*, int))dlsym(handle, "skedia_row");
+	if(!init || !point || !row){
+		dlclose(handle);
+		return 0;
+	}
+	
+	void *ptrs[COMPILE_MAX_FUNCS];
+	for(int i = 0; i < func_count; i++) ptrs[i] = (void*)(funcs[i].n_arg);
+	init(ptrs);
+	
+	// The handle is kept open until the equation is reparsed or removed
+	eq->native = point;
+	eq->native_row = row;
+	eq->native_handle = handle;
+	eq->native_close = dlclose;
+	return 1;
+}
+
+bool compile_equat(equat_t eq){
+	bool ok = compile_native(eq);
+	eq->compile_failed = !ok;
+	return ok;
+}
+
+int compile_equats(equat_t gallery){
+	int count = 0;
+	for(equat_t eq = gallery; eq; eq = eq->next){
+		if(!(eq->is_variable) && eq->right && !(eq->native) && !(eq->compile_failed)) count += compile_equat(eq);
+	}
+	return count;
+}
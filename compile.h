@@ -0,0 +1,33 @@
+#ifndef _COMPILE_H
+#define _COMPILE_H
+
+#include <stdbool.h>
+
+#include "gallery.h"
+
+/* Ahead of time compilation of proper equations to native code
+ * Each equation is written as C source, compiled into a shared object with the system C compiler,
+ * and loaded with dlopen, after which eval_equat and sample_equats call it instead of interpreting
+ *
+ * Objects are cached in $XDG_CACHE_HOME/skedia (or ~/.cache/skedia) named by a hash of their source,
+ * the compiler command, and the CPU they are tuned for, so later runs with the same equations skip the compiler entirely
+ * The cache must be a directory private to the user, otherwise objects are built in a temporary directory and removed once loaded
+ * The compiler is taken from $CC and defaults to cc
+ *
+ * Reparsing or removing an equation closes its native code so edited equations are interpreted until they are compiled again
+ */
+
+// Most builtins without a C library equivalent that the code of one equation can call
+#define COMPILE_MAX_FUNCS 32
+// Most memoized variables and functions that the code of one equation can reference
+#define COMPILE_MAX_REFS 256
+
+// Compile eq to native code, loading it from the cache if it was compiled before
+// Returns false if eq isn't a usable proper equation or it could not be compiled (it is then interpreted)
+bool compile_equat(equat_t eq);
+// Compile every proper equation of gallery without native code (e.g. since it was reparsed)
+// Equations that failed to compile are skipped until they are reparsed
+// Returns the number of equations compiled
+int compile_equats(equat_t gallery);
+
+#endif
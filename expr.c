@@ -1,16 +1,18 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
-#include <strings.h>
 #include <math.h>
 #include <ctype.h>
 
 #include "expr.h"
+#include "stats.h"
 
 
 /* Represent the different types of expressions
  * CONST - numeric literals (e.g. 1, 2.5, -3) and constants (e.g. e, pi)
  * ARGS - arguments to expression. Represented by index (e.g. 0 -> first argument)
  * CACHED - evaluates to the value referenced by a double value
+ * MEMO - evaluates to the value of another expression memoized for the current epoch
  * VAR - outside functions or variables defined by other expressions
  * FUNC1, FUNC2, FUNCN - builtin functions of arity 1, 2, or more, respectively. Represented by function pointer
  * ADD - sum and difference of expressions
@@ -18,7 +20,7 @@
  * POW - exponentiation of expressions
  */
 enum expr_type{
-	EXPR_CONST, EXPR_ARGS, EXPR_CACHED,
+	EXPR_CONST, EXPR_ARGS, EXPR_CACHED, EXPR_MEMO,
 	EXPR_VAR, EXPR_FUNC1, EXPR_FUNC2, EXPR_FUNCN,
 	EXPR_ADD, EXPR_MUL, EXPR_POW,
 	
@@ -28,6 +30,13 @@ enum expr_type{
 	EXPR_PARENTH, EXPR_COMMA
 };
 
+const char *expr_type_names[EXPR_TYPE_COUNT] = {
+	"const", "args", "cached", "memo",
+	"var", "func1", "func2", "funcn",
+	"add", "mul", "pow",
+	"parenth", "comma"
+};
+
 
 struct expr_s{
 	enum expr_type type;
@@ -43,6 +52,8 @@ struct expr_s{
 		int arg_ind;
 		// EXPR_CACHED
 		double *cache;
+		// EXPR_MEMO
+		expr_memo_t *memo;
 		
 		struct{
 			union{
@@ -53,6 +64,10 @@ struct expr_s{
 				
 				// EXPR_FUNC1, EXPR_FUNC2, EXPR_FUNC3, EXPR_FUNCN
 				union expr_func_u func;
+				
+				// EXPR_ADD, EXPR_MUL while parsing
+				// Last child so terms are appended in constant time
+				expr_t last;
 			};
 			
 			// Used by VAR, FUNC1, FUNC2, FUNC3, FUNCN, ADD, MULT, POW
@@ -65,29 +80,45 @@ struct expr_s{
 
 
 
-// Frees memory used by children of expression only
-void free_expr_no_self(expr_t exp){
-	// Only free children if given type has children
-	if(exp->type == EXPR_VAR
+// Check if the given type of expression has children
+static bool has_children(expr_t exp){
+	return exp->type == EXPR_VAR
 	|| exp->type == EXPR_FUNC1
 	|| exp->type == EXPR_FUNC2
 	|| exp->type == EXPR_FUNCN
 	|| exp->type == EXPR_ADD
 	|| exp->type == EXPR_MUL
-	|| exp->type == EXPR_POW
-	){
-		expr_t child = exp->children, tmp;
-		while(child){
-			free_expr_no_self(child);
-			tmp = child->next;
-			free(child);
-			child = tmp;
+	|| exp->type == EXPR_POW;
+}
+
+// Frees memory used by children of expression only
+void free_expr_no_self(expr_t exp){
+	// Only free children if given type has children
+	if(!has_children(exp)) return;
+	
+	// Nodes waiting to be freed are chained through their siblings
+	// and the children of each freed node are spliced in front so no stack is needed however deep exp is
+	expr_t list = exp->children;
+	while(list){
+		expr_t node = list;
+		list = node->next;
+		if(has_children(node) && node->children){
+			expr_t last = node->children;
+			while(last->next) last = last->next;
+			last->next = list;
+			list = node->children;
 		}
+		free(node);
 	}
 }
 
 
 
+// Current epoch for memoized values
+unsigned long expr_memo_epoch = 1;
+
+
+
 // Allocate memory on heap for new expression
 expr_t new_expr(void){
 	return malloc(sizeof(struct expr_s));
@@ -103,6 +134,7 @@ void free_expr(expr_t exp){
 // Evaluate value of expression by evaluating children and using other expressions stored in variables
 double eval_expr(expr_t exp, double *args){
 	if(!exp) return 0;
+	stats.evals[exp->type]++;
 	
 	double result;
 	switch(exp->type){
@@ -118,6 +150,14 @@ double eval_expr(expr_t exp, double *args){
 		break;
 		case EXPR_CACHED: result = *(exp->cache);
 		break;
+		case EXPR_MEMO:
+			// Recalculate value if it hasn't been calculated during this epoch
+			if(exp->memo->stamp != expr_memo_epoch){
+				exp->memo->value = eval_expr(exp->memo->ref, NULL);
+				exp->memo->stamp = expr_memo_epoch;
+			}
+			result = exp->memo->value;
+		break;
 		
 		case EXPR_FUNC1:
 			result = eval_expr(exp->children, args);
@@ -129,7 +169,8 @@ double eval_expr(expr_t exp, double *args){
 		break;
 		
 		case EXPR_ADD:
-			result = 0;
+			// Sums start from -0 which is the identity even for a first term of -0
+			result = -0.0;
 			for(expr_t c = exp->children; c; c = c->next){
 				result += eval_expr(c, args);
 			}
@@ -167,12 +208,30 @@ double eval_expr(expr_t exp, double *args){
 	return result;
 }
 
+void expr_set_precision(expr_t exp, expr_precision_t precision){
+	switch(exp->type){
+		case EXPR_FUNC1:
+		case EXPR_FUNC2:
+		case EXPR_FUNCN: exp->func = expr_builtin_variant(exp->func, precision);
+		// fall through
+		case EXPR_VAR:
+		case EXPR_ADD:
+		case EXPR_MUL:
+		case EXPR_POW:
+			for(expr_t c = exp->children; c; c = c->next) expr_set_precision(c, precision);
+		break;
+		
+		default:
+		break;
+	}
+}
+
 
 
 expr_t constify_expr(expr_t exp){
 	// Constants (e.g. 1, 2, 3.14) are already constant
 	// Arguments (e.g. x, y, z) cannot be made constant
-	if(exp->type == EXPR_CONST || exp->type == EXPR_ARGS || exp->type == EXPR_CACHED) return exp;
+	if(exp->type == EXPR_CONST || exp->type == EXPR_ARGS || exp->type == EXPR_CACHED || exp->type == EXPR_MEMO) return exp;
 	
 	bool is_const = 1;
 	for(expr_t child = exp->children; child; child = child->next){
@@ -196,6 +255,1205 @@ expr_t constify_expr(expr_t exp){
 	return exp;
 }
 
+// Largest integer exponent (in magnitude) evaluated by repeated multiplication instead of pow
+#define SIMPLIFY_POW_MAX 64
+// Largest integer exponent of a leaf written out as a product of copies of it
+#define SIMPLIFY_MUL_MAX 4
+// Highest degree of a polynomial put in Horner's form
+#define SIMPLIFY_HORNER_MAX 16
+// Most leaves of a sum tried as the variable of a polynomial, each costing a pass over the terms
+#define SIMPLIFY_HORNER_VARS 4
+// Largest body (in nodes) of a function copied into the expressions calling it
+#define SIMPLIFY_INLINE_MAX 64
+
+// Raise b to the integer power n by repeated squaring
+// Replaces pow for constant integer exponents
+static double expr_powi(double b, double n){
+	long k = (long)n;
+	bool inv = k < 0;
+	if(inv) k = -k;
+	
+	double result = 1;
+	while(k){
+		if(k & 1) result *= b;
+		k >>= 1;
+		if(k) b *= b;
+	}
+	return inv ? 1 / result : result;
+}
+
+static bool is_leaf(expr_t exp){
+	return exp->type == EXPR_CONST || exp->type == EXPR_ARGS || exp->type == EXPR_CACHED || exp->type == EXPR_MEMO;
+}
+
+// Allocate a copy of a leaf without its siblings
+static expr_t copy_leaf(expr_t exp){
+	expr_t cp = new_expr();
+	*cp = *exp;
+	cp->next = NULL;
+	return cp;
+}
+
+// Allocate a constant without any inversions
+static expr_t new_const(double c){
+	expr_t exp = new_expr();
+	exp->type = EXPR_CONST;
+	exp->next = NULL;
+	exp->add_inv = 0;
+	exp->mul_inv = 0;
+	exp->constant = c;
+	return exp;
+}
+
+// Allocate a sum or product of a and b
+static expr_t new_pair(enum expr_type type, expr_t a, expr_t b){
+	expr_t exp = new_expr();
+	exp->type = type;
+	exp->next = NULL;
+	exp->add_inv = 0;
+	exp->mul_inv = 0;
+	
+	a->next = b;
+	b->next = NULL;
+	exp->children = a;
+	exp->last = b;
+	exp->child_count = 2;
+	return exp;
+}
+
+// Replace exp by the constant it evaluates to keeping its place among its siblings
+static void fold_const(expr_t exp){
+	double c = eval_expr(exp, NULL);
+	free_expr_no_self(exp);
+	exp->type = EXPR_CONST;
+	exp->add_inv = 0;
+	exp->mul_inv = 0;
+	exp->constant = c;
+}
+
+// Move the node with into exp keeping the place of exp among its siblings and freeing the shell of with
+// Negation and reciprocal commute and undo themselves so the inversions of both combine by exclusive or
+static void replace_node(expr_t exp, expr_t with){
+	expr_t next = exp->next;
+	bool add_inv = exp->add_inv ^ with->add_inv, mul_inv = exp->mul_inv ^ with->mul_inv;
+	
+	*exp = *with;
+	exp->next = next;
+	exp->add_inv = add_inv;
+	exp->mul_inv = mul_inv;
+	free(with);
+}
+
+// Replace exp by its first child
+// Any other children must already be removed
+static void lift_child(expr_t exp){
+	replace_node(exp, exp->children);
+}
+
+// Recount the children of a sum or product after they were rearranged
+static void count_children(expr_t exp){
+	exp->child_count = 0;
+	for(expr_t c = exp->children; c; c = c->next){
+		exp->child_count++;
+		exp->last = c;
+	}
+}
+
+// Rewrite sec, csc, and cot as reciprocals of cos, sin, and tan
+// so they cancel with other reciprocals instead of dividing inside the builtin
+static void simplify_trig(expr_t exp){
+	static const char *recips[][2] = {{"sec", "cos"}, {"csc", "sin"}, {"cot", "tan"}};
+	for(int i = 0; i < 3; i++){
+		const expr_builtin_t *from = expr_find_builtin(recips[i][0], 3);
+		if(from && exp->func.one_arg == from->func.one_arg){
+			exp->func.one_arg = expr_find_builtin(recips[i][1], 3)->func.one_arg;
+			exp->mul_inv = !(exp->mul_inv);
+			return;
+		}
+	}
+}
+
+// Replace powers with constant integer exponents by products or repeated squaring
+static void simplify_pow(expr_t exp){
+	expr_t base = exp->children, power = base->next;
+	if(power->type != EXPR_CONST) return;
+	if(base->type == EXPR_CONST){
+		fold_const(exp);
+		return;
+	}
+	
+	double n = eval_expr(power, NULL);
+	if(n != floor(n) || fabs(n) > SIMPLIFY_POW_MAX) return;
+	
+	// Move inversions of the base outside since (1 / b)^n = b^-n and (-b)^n = (-1)^n * b^n
+	if(base->mul_inv){
+		base->mul_inv = 0;
+		n = -n;
+	}
+	if(base->add_inv){
+		base->add_inv = 0;
+		if(fmod(n, 2) != 0) exp->add_inv = !(exp->add_inv);
+	}
+	
+	if(n == 0){
+		// b^0 is 1 even for infinite and NaN b
+		free_expr_no_self(exp);
+		exp->type = EXPR_CONST;
+		exp->constant = 1;
+	}else if(n == 1 || n == -1){
+		free(power);
+		if(n == -1) exp->mul_inv = !(exp->mul_inv);
+		lift_child(exp);
+	}else if(is_leaf(base) && fabs(n) <= SIMPLIFY_MUL_MAX){
+		// Multiply copies of the leaf together
+		free(power);
+		expr_t tail = base;
+		for(int i = 1; i < fabs(n); i++){
+			tail->next = copy_leaf(base);
+			tail = tail->next;
+		}
+		tail->next = NULL;
+		
+		exp->type = EXPR_MUL;
+		count_children(exp);
+		if(n < 0) exp->mul_inv = !(exp->mul_inv);
+	}else{
+		power->add_inv = 0;
+		power->mul_inv = 0;
+		power->constant = n;
+		exp->type = EXPR_FUNC2;
+		exp->func.two_arg = expr_powi;
+	}
+}
+
+// Splice the children of an uninverted sum leading a sum (or a product leading a product) into it
+// Children are evaluated in order so splicing a later group would round its terms differently
+// Inverted ones are kept whole since inverting the group once is cheaper than each of its children
+static void flatten(expr_t exp){
+	expr_t c = exp->children;
+	while(c->type == exp->type && !(c->add_inv) && !(c->mul_inv)){
+		// c was simplified already so its last child is known
+		c->last->next = c->next;
+		exp->children = c->children;
+		free(c);
+		c = exp->children;
+	}
+}
+
+// Combine the constants leading the children of a sum or product into a single constant placed first
+// Later constants stay in place since moving them would change the order the terms are rounded in
+// but identities and factors of -1 are taken out wherever they are since that is exact
+// The constant is left out when it is the identity and there are other children
+// The identity of sums is -0 since adding +0 turns -0 into +0 and the sign of a zero matters (e.g. to atan2)
+static void merge_consts(expr_t exp){
+	bool is_add = exp->type == EXPR_ADD;
+	double value = is_add ? -0.0 : 1;
+	int consts = 0;
+	
+	while(exp->children && exp->children->type == EXPR_CONST){
+		expr_t c = exp->children;
+		value = is_add ? value + eval_expr(c, NULL) : value * eval_expr(c, NULL);
+		consts++;
+		exp->children = c->next;
+		free(c);
+	}
+	
+	for(expr_t *link = &(exp->children); *link;){
+		expr_t c = *link;
+		double v = c->type == EXPR_CONST ? eval_expr(c, NULL) : NAN;
+		if(!is_add && v == -1){
+			exp->add_inv = !(exp->add_inv);
+			v = 1;
+		}
+		if(is_add ? v == 0 && signbit(v) : v == 1){
+			*link = c->next;
+			free(c);
+		}else{
+			link = &(c->next);
+		}
+	}
+	if(consts == 0) return;
+	
+	// A factor of -1 becomes a negation of the product
+	if(!is_add && exp->children && value == -1){
+		exp->add_inv = !(exp->add_inv);
+		value = 1;
+	}
+	bool identity = is_add ? value == 0 && signbit(value) : value == 1;
+	if(!(exp->children) || !identity){
+		expr_t c = new_const(value);
+		c->next = exp->children;
+		exp->children = c;
+	}
+}
+
+// Divide once by the product of the reciprocal factors of a product instead of once for each of them
+static void group_reciprocals(expr_t exp){
+	int count = 0;
+	for(expr_t c = exp->children; c; c = c->next) count += c->mul_inv;
+	if(count < 2) return;
+	
+	expr_t denom = new_expr(), tail = NULL;
+	denom->type = EXPR_MUL;
+	denom->add_inv = 0;
+	denom->mul_inv = 1;
+	denom->children = NULL;
+	for(expr_t *link = &(exp->children); *link;){
+		expr_t c = *link;
+		if(c->mul_inv){
+			*link = c->next;
+			c->mul_inv = 0;
+			c->next = NULL;
+			if(tail) tail->next = c;
+			else denom->children = c;
+			tail = c;
+		}else{
+			link = &(c->next);
+		}
+	}
+	count_children(denom);
+	
+	// Place the divisor last
+	expr_t *link = &(exp->children);
+	while(*link) link = &((*link)->next);
+	denom->next = NULL;
+	*link = denom;
+}
+
+// Leaf which term is a constant multiple of a power of, or NULL if it isn't one
+static expr_t term_var(expr_t term){
+	if(term->mul_inv) return NULL;
+	if(is_leaf(term)) return term->type == EXPR_CONST ? NULL : term;
+	if(term->type != EXPR_MUL) return NULL;
+	
+	for(expr_t c = term->children; c; c = c->next){
+		if(c->type != EXPR_CONST) return is_leaf(c) && !(c->add_inv) && !(c->mul_inv) ? c : NULL;
+	}
+	return NULL;
+}
+
+// Degree of term as a constant multiple of a power of the leaf var, setting coef to the constant
+// Returns 0 if term isn't one
+static int term_degree(expr_t term, expr_t var, double *coef){
+	if(term->mul_inv) return 0;
+	if(is_leaf(term)){
+		if(term->type == EXPR_CONST || !expr_match(term, var)) return 0;
+		*coef = term->add_inv ? -1 : 1;
+		return 1;
+	}
+	if(term->type != EXPR_MUL) return 0;
+	
+	int deg = 0;
+	double c = 1;
+	for(expr_t f = term->children; f; f = f->next){
+		if(f->type == EXPR_CONST) c *= eval_expr(f, NULL);
+		else if(is_leaf(f) && !(f->add_inv) && !(f->mul_inv) && expr_match(f, var)) deg++;
+		else return 0;
+	}
+	*coef = term->add_inv ? -c : c;
+	return deg;
+}
+
+// Put the terms of a sum that form a polynomial in a single leaf in Horner's form
+// a_n * v^n + ... + a_1 * v becomes (((a_n * v + a_n-1) * v + ...) + a_1) * v
+// Each leaf is tried once so the terms are scanned at most SIMPLIFY_HORNER_VARS times
+static void horner(expr_t exp){
+	double coefs[SIMPLIFY_HORNER_MAX + 1], coef;
+	expr_t tried[SIMPLIFY_HORNER_VARS];
+	int tried_count = 0;
+	for(expr_t c = exp->children; c && tried_count < SIMPLIFY_HORNER_VARS; c = c->next){
+		expr_t var = term_var(c);
+		if(!var) continue;
+		bool seen = 0;
+		for(int i = 0; i < tried_count && !seen; i++) seen = expr_match(tried[i], var);
+		if(seen) continue;
+		tried[tried_count++] = var;
+		
+		// Collect the coefficients of every term in var
+		int terms = 0, degree = 0, d;
+		for(int k = 0; k <= SIMPLIFY_HORNER_MAX; k++) coefs[k] = 0;
+		for(expr_t t = exp->children; t; t = t->next){
+			if((d = term_degree(t, var, &coef)) == 0) continue;
+			if(d > SIMPLIFY_HORNER_MAX){
+				terms = 0;
+				break;
+			}
+			terms++;
+			coefs[d] += coef;
+			if(d > degree) degree = d;
+		}
+		while(degree > 0 && coefs[degree] == 0) degree--;
+		if(terms < 2 || degree < 2) continue;
+		
+		// Build the polynomial from the leading coefficient down
+		expr_t v = copy_leaf(var);
+		v->add_inv = 0;
+		v->mul_inv = 0;
+		expr_t poly = new_const(coefs[degree]);
+		for(int k = degree - 1; k >= 0; k--){
+			poly = new_pair(EXPR_MUL, poly, copy_leaf(v));
+			if(k > 0 && coefs[k] != 0) poly = new_pair(EXPR_ADD, poly, new_const(coefs[k]));
+		}
+		simplify_expr(poly);
+		
+		// Replace the terms with the polynomial
+		// v stands in for var which is freed along with its term
+		for(expr_t *link = &(exp->children); *link;){
+			expr_t t = *link;
+			if(term_degree(t, v, &coef) > 0){
+				*link = t->next;
+				t->next = NULL;
+				free_expr(t);
+			}else{
+				link = &(t->next);
+			}
+		}
+		free(v);
+		
+		expr_t *link = &(exp->children);
+		while(*link) link = &((*link)->next);
+		*link = poly;
+		return;
+	}
+}
+
+// Number of nodes in exp, counting no further than max
+static int count_nodes(expr_t exp, int max){
+	int count = 1;
+	if(is_leaf(exp)) return count;
+	for(expr_t c = exp->children; c && count <= max; c = c->next){
+		count += count_nodes(c, max - count);
+	}
+	return count;
+}
+
+// Number of references to the arg_ind'th argument in exp
+static int count_arg_uses(expr_t exp, int arg_ind){
+	if(exp->type == EXPR_ARGS) return exp->arg_ind == arg_ind;
+	if(is_leaf(exp)) return 0;
+	
+	int count = 0;
+	for(expr_t c = exp->children; c; c = c->next) count += count_arg_uses(c, arg_ind);
+	return count;
+}
+
+// Allocate a copy of exp (without its siblings) with every argument replaced by a copy of args[arg_ind]
+// The arguments themselves are copied as they are when args is NULL
+static expr_t substitute(expr_t exp, expr_t *args){
+	expr_t cp;
+	if(exp->type == EXPR_ARGS && args){
+		cp = substitute(args[exp->arg_ind], NULL);
+		cp->add_inv = cp->add_inv ^ exp->add_inv;
+		cp->mul_inv = cp->mul_inv ^ exp->mul_inv;
+		return cp;
+	}
+	
+	cp = copy_leaf(exp);
+	if(is_leaf(exp)) return cp;
+	
+	expr_t *link = &(cp->children);
+	for(expr_t c = exp->children; c; c = c->next){
+		*link = substitute(c, args);
+		link = &((*link)->next);
+	}
+	*link = NULL;
+	if(exp->type == EXPR_ADD || exp->type == EXPR_MUL) count_children(cp);
+	return cp;
+}
+
+// Replace a call to a function defined by another equation with a copy of its body
+// where the argument expressions stand in for its parameters
+// Calls are kept when the body is large or an argument that isn't a leaf would be evaluated more than once
+// Returns whether the call was replaced
+static bool inline_call(expr_t exp){
+	expr_t body = exp->ref;
+	if(count_nodes(body, SIMPLIFY_INLINE_MAX) > SIMPLIFY_INLINE_MAX) return 0;
+	
+	expr_t args[exp->child_count > 0 ? exp->child_count : 1];
+	int i = 0;
+	for(expr_t c = exp->children; c; c = c->next, i++){
+		if(!is_leaf(c) && count_arg_uses(body, i) > 1) return 0;
+		args[i] = c;
+	}
+	
+	body = substitute(body, args);
+	free_expr_no_self(exp);
+	replace_node(exp, body);
+	return 1;
+}
+
+// Simplify exp once its children are simplified
+// Returns whether exp was replaced by the body of the function it called which must be simplified in turn
+static bool simplify_node(expr_t exp){
+	bool is_const = 1;
+	for(expr_t c = exp->children; c; c = c->next){
+		if(c->type != EXPR_CONST) is_const = 0;
+	}
+	
+	switch(exp->type){
+		// Functions defined by other equations may depend on x and y even with constant arguments
+		// so they are only folded once inlined and specialized to their arguments
+		case EXPR_VAR: return inline_call(exp);
+		
+		case EXPR_FUNC1:
+			simplify_trig(exp);
+		// fall through
+		case EXPR_FUNC2:
+		case EXPR_FUNCN:
+			if(is_const) fold_const(exp);
+		break;
+		
+		case EXPR_POW:
+			simplify_pow(exp);
+		break;
+		
+		case EXPR_ADD:
+		case EXPR_MUL:
+			flatten(exp);
+			merge_consts(exp);
+			if(exp->type == EXPR_ADD) horner(exp);
+			else group_reciprocals(exp);
+			
+			count_children(exp);
+			if(exp->child_count == 1) lift_child(exp);
+		break;
+		
+		// Leaves aren't simplified
+		// and the rest won't occur as types of actual nodes
+		default:
+		break;
+	}
+	return 0;
+}
+
+// Node on the stack simplify_expr walks an expression with
+struct simplify_frame_s{
+	expr_t exp;
+	// Whether the children of exp are pushed above it
+	bool expanded;
+};
+
+expr_t simplify_expr(expr_t exp){
+	// Children are simplified in place before their parents so the list stays intact
+	// The stack is explicit so deeply nested expressions can't overflow the call stack
+	size_t top = 0, max = 64;
+	struct simplify_frame_s *stack = malloc(max * sizeof(struct simplify_frame_s));
+	if(!stack) return exp;
+	stack[top++] = (struct simplify_frame_s){exp, 0};
+	
+	while(top > 0){
+		struct simplify_frame_s *frame = stack + top - 1;
+		expr_t node = frame->exp;
+		if(is_leaf(node)){
+			top--;
+		}else if(frame->expanded){
+			// An inlined call is simplified again as its body
+			top--;
+			if(simplify_node(node)) stack[top++] = (struct simplify_frame_s){node, 0};
+		}else{
+			frame->expanded = 1;
+			for(expr_t c = node->children; c; c = c->next){
+				if(top == max){
+					// Nodes are only simplified after their children so stopping early leaves exp intact
+					struct simplify_frame_s *grown = realloc(stack, 2 * max * sizeof(struct simplify_frame_s));
+					if(!grown){
+						free(stack);
+						return exp;
+					}
+					stack = grown;
+					max *= 2;
+				}
+				stack[top++] = (struct simplify_frame_s){c, 0};
+			}
+		}
+	}
+	
+	free(stack);
+	return exp;
+}
+
+// Nodes visited through the references of a subexpression before it is assumed to read a varying value
+#define HOIST_BUDGET 1024
+
+// Check if exp reads any of the n values pointed to by varying
+// Gives up and returns true once *budget nodes have been visited
+static bool reads_varying(expr_t exp, double *const *varying, int n, int *budget){
+	if(!exp) return 0;
+	if(--(*budget) < 0) return 1;
+	
+	switch(exp->type){
+		case EXPR_CACHED:
+			for(int i = 0; i < n; i++){
+				if(exp->cache == varying[i]) return 1;
+			}
+		return 0;
+		
+		case EXPR_MEMO: return reads_varying(exp->memo->ref, varying, n, budget);
+		
+		case EXPR_VAR:
+			if(reads_varying(exp->ref, varying, n, budget)) return 1;
+		// fall through
+		case EXPR_FUNC1:
+		case EXPR_FUNC2:
+		case EXPR_FUNCN:
+		case EXPR_ADD:
+		case EXPR_MUL:
+		case EXPR_POW:
+			for(expr_t c = exp->children; c; c = c->next){
+				if(reads_varying(c, varying, n, budget)) return 1;
+			}
+		return 0;
+		
+		default: return 0;
+	}
+}
+
+int expr_hoist(expr_t exp, double *const *varying, int n, expr_hoist_t *hoists, int max){
+	// Only leaves which are evaluated by following a reference are worth hoisting
+	if(!exp || max <= 0 || exp->type == EXPR_CONST || exp->type == EXPR_ARGS || exp->type == EXPR_CACHED) return 0;
+	
+	int budget = HOIST_BUDGET;
+	if(!reads_varying(exp, varying, n, &budget)){
+		// Move the node out whole, leaving one which reads the hoisted value in its place
+		expr_hoist_t *h = hoists;
+		h->node = exp;
+		h->hoisted = copy_leaf(exp);
+		h->value = 0;
+		
+		exp->type = EXPR_CACHED;
+		exp->add_inv = 0;
+		exp->mul_inv = 0;
+		exp->cache = &(h->value);
+		return 1;
+	}
+	if(exp->type == EXPR_MEMO) return 0;
+	
+	// Arguments of functions are evaluated by the caller so they can be hoisted too
+	int count = 0;
+	for(expr_t c = exp->children; c; c = c->next){
+		count += expr_hoist(c, varying, n, hoists + count, max - count);
+	}
+	return count;
+}
+
+void expr_unhoist(expr_hoist_t *hoists, int count){
+	for(int i = count - 1; i >= 0; i--){
+		expr_t next = hoists[i].node->next;
+		*(hoists[i].node) = *(hoists[i].hoisted);
+		hoists[i].node->next = next;
+		free(hoists[i].hoisted);
+	}
+}
+
+// Functions of the C library pointed to by the builtins
+// Emitted code calls them by name so the compiler can inline them
+static const struct{
+	double (*func)(double);
+	const char *name;
+} emit_libm[] = {
+	{sqrt, "sqrt"}, {cbrt, "cbrt"}, {exp, "exp"}, {log, "log"}, {log10, "log10"},
+	{sin, "sin"}, {cos, "cos"}, {tan, "tan"}, {sinh, "sinh"}, {cosh, "cosh"}, {tanh, "tanh"},
+	{asin, "asin"}, {acos, "acos"}, {atan, "atan"}, {fabs, "fabs"}, {ceil, "ceil"}, {floor, "floor"}
+};
+
+// Write c as a C constant with the exact same value
+static void emit_const(FILE *fp, double c){
+	if(isnan(c)) fprintf(fp, "NAN");
+	else if(isinf(c)) fprintf(fp, c > 0 ? "INFINITY" : "(-INFINITY)");
+	else if(signbit(c)) fprintf(fp, "(%a)", c);
+	else fprintf(fp, "%a", c);
+}
+
+// Index of the builtin fn in the pointer table of ctx adding it if it isn't there yet
+// Returns -1 if the table is full
+static int emit_func(expr_emit_t *ctx, union expr_func_u fn){
+	for(int i = 0; i < ctx->func_count; i++){
+		if(ctx->funcs[i].n_arg == fn.n_arg) return i;
+	}
+	if(ctx->func_count >= ctx->max_funcs) return -1;
+	ctx->funcs[ctx->func_count] = fn;
+	return ctx->func_count++;
+}
+
+// Write the children of exp separated by sep
+static bool emit_children(FILE *fp, expr_t exp, const char *sep, expr_emit_t *ctx){
+	bool ok = 1;
+	for(expr_t c = exp->children; c && ok; c = c->next){
+		if(c != exp->children) fprintf(fp, "%s", sep);
+		ok = expr_emit(fp, c, ctx);
+	}
+	return ok;
+}
+
+bool expr_emit(FILE *fp, expr_t exp, expr_emit_t *ctx){
+	// Negation is applied before the reciprocal like in eval_expr
+	if(exp->mul_inv) fprintf(fp, "(1 / ");
+	if(exp->add_inv) fprintf(fp, "-(");
+	
+	bool ok = 1;
+	int i;
+	switch(exp->type){
+		case EXPR_CONST: emit_const(fp, exp->constant);
+		break;
+		case EXPR_ARGS: fprintf(fp, "a[%d]", exp->arg_ind);
+		break;
+		case EXPR_CACHED:
+			for(i = 0; i < ctx->cache_count && ctx->caches[i] != exp->cache; i++){}
+			if(i < ctx->cache_count) fprintf(fp, "%s", ctx->cache_names[i]);
+			else ok = 0;
+		break;
+		
+		case EXPR_MEMO:
+			for(i = 0; i < ctx->memo_count && ctx->memos[i] != exp->memo; i++){}
+			if(i == ctx->memo_count){
+				if(i >= ctx->max_memos) return 0;
+				ctx->memos[ctx->memo_count++] = exp->memo;
+			}
+			fprintf(fp, "m%d(x, y, r)", i);
+		break;
+		case EXPR_VAR:
+			for(i = 0; i < ctx->ref_count && ctx->refs[i] != exp->ref; i++){}
+			if(i == ctx->ref_count){
+				if(i >= ctx->max_refs) return 0;
+				ctx->refs[ctx->ref_count++] = exp->ref;
+			}
+			fprintf(fp, "f%d(x, y, r, (const double[]){", i);
+			if(exp->children) ok = emit_children(fp, exp, ", ", ctx);
+			else fprintf(fp, "0");
+			fprintf(fp, "})");
+		break;
+		
+		case EXPR_FUNC1:
+			for(i = 0; i < (int)(sizeof(emit_libm) / sizeof(emit_libm[0])) && emit_libm[i].func != exp->func.one_arg; i++){}
+			if(i < (int)(sizeof(emit_libm) / sizeof(emit_libm[0]))){
+				fprintf(fp, "%s(", emit_libm[i].name);
+			}else{
+				if((i = emit_func(ctx, exp->func)) < 0) return 0;
+				fprintf(fp, "((double (*)(double))fn[%d])(", i);
+			}
+			ok = emit_children(fp, exp, ", ", ctx);
+			fprintf(fp, ")");
+		break;
+		case EXPR_FUNC2:
+			if(exp->func.two_arg == atan2){
+				fprintf(fp, "atan2(");
+			}else{
+				if((i = emit_func(ctx, exp->func)) < 0) return 0;
+				fprintf(fp, "((double (*)(double, double))fn[%d])(", i);
+			}
+			ok = emit_children(fp, exp, ", ", ctx);
+			fprintf(fp, ")");
+		break;
+		case EXPR_FUNCN:
+			if((i = emit_func(ctx, exp->func)) < 0) return 0;
+			fprintf(fp, "((double (*)(double*))fn[%d])((double[]){", i);
+			ok = emit_children(fp, exp, ", ", ctx);
+			fprintf(fp, "})");
+		break;
+		
+		case EXPR_ADD:
+		case EXPR_MUL:
+			if(!(exp->children)){
+				fprintf(fp, exp->type == EXPR_ADD ? "0" : "1");
+				break;
+			}
+			fprintf(fp, "(");
+			ok = emit_children(fp, exp, exp->type == EXPR_ADD ? " + " : " * ", ctx);
+			fprintf(fp, ")");
+		break;
+		case EXPR_POW:
+			fprintf(fp, "pow(");
+			ok = emit_children(fp, exp, ", ", ctx);
+			fprintf(fp, ")");
+		break;
+		
+		// Used during parsing
+		// But won't occur as types of actual nodes
+		default: return 0;
+	}
+	
+	if(exp->add_inv) fprintf(fp, ")");
+	if(exp->mul_inv) fprintf(fp, ")");
+	return ok;
+}
+
+// Node of a packed expression
+// Nodes are stored in pre-order with the children of each node in reverse,
+// so evaluating them from last to first leaves the values of the children of a node on the stack in order
+struct expr_node_s{
+	uint8_t type;
+	bool add_inv : 1, mul_inv : 1;
+	uint16_t child_count;
+	// Number of nodes in the subtree including this one
+	uint32_t size;
+	// CONST: index into consts, ARGS: argument index,
+	// CACHED, MEMO, VAR: index into ptrs and roots, FUNC1, FUNC2, FUNCN: function id
+	uint32_t operand;
+};
+_Static_assert(sizeof(struct expr_node_s) <= 16, "packed nodes must stay small");
+
+// Root of a memo or function without an expression
+#define PACK_NONE UINT32_MAX
+
+struct expr_pack_s{
+	// The expression itself is the region of nodes starting at the first
+	// Each variable and function it references is packed once into its own region after it
+	struct expr_node_s *nodes;
+	double *consts;
+	// CACHED: the cache, MEMO: the memo, VAR: the body of the function
+	void **ptrs;
+	// MEMO, VAR: index of the root of the region evaluated for the node or PACK_NONE
+	uint32_t *roots;
+	
+	// Most values on the stack and most calls in progress at once while evaluating
+	uint32_t stack_size, call_depth;
+};
+
+// Functions called by packed expressions indexed by their ids in each precision
+static union expr_func_u func_ids[EXPR_MAX_FUNC_IDS], fast_func_ids[EXPR_MAX_FUNC_IDS];
+static int func_id_count = 0;
+
+// Id of fn assigning it one if it hasn't been assigned yet
+// Both precisions of a builtin share an id
+// Returns -1 if every id is taken
+static int func_id(union expr_func_u fn){
+	fn = expr_builtin_variant(fn, EXPR_PRECISE);
+	for(int i = 0; i < func_id_count; i++){
+		if(func_ids[i].n_arg == fn.n_arg) return i;
+	}
+	if(func_id_count >= EXPR_MAX_FUNC_IDS) return -1;
+	func_ids[func_id_count] = fn;
+	fast_func_ids[func_id_count] = expr_builtin_variant(fn, EXPR_FAST);
+	return func_id_count++;
+}
+
+// Expression of a variable or function packed into its own region
+struct pack_region_s{
+	expr_t exp;
+	uint32_t root;
+	// Stack and calls needed to evaluate the region, valid once measured
+	uint32_t stack, depth;
+	bool measured;
+};
+
+// State while packing an expression
+struct pack_build_s{
+	expr_pack_t pk;
+	// Nodes, constants, and pointers counted and later filled
+	size_t nodes, consts, ptrs;
+	// Region 0 is the expression itself
+	struct pack_region_s *regions;
+	int region_count, region_max;
+	
+	// Stack of the nodes waiting to be counted or filled (or regions waiting to be measured)
+	// so expressions are walked without recursing however deeply they are nested
+	union{
+		expr_t exp;
+		int region;
+	} *stack;
+	size_t stack_max;
+};
+
+// Make room for one more entry on top of the top entries of the stack of b
+static bool reserve_stack(struct pack_build_s *b, size_t top){
+	if(top < b->stack_max) return 1;
+	size_t max = b->stack_max ? 2 * b->stack_max : 64;
+	void *grown = realloc(b->stack, max * sizeof(*(b->stack)));
+	if(!grown) return 0;
+	b->stack = grown;
+	b->stack_max = max;
+	return 1;
+}
+
+// Find the region exp is packed into adding it if it isn't yet
+// New regions are counted by expr_pack once the expression referencing them is
+// Returns its index, PACK_NONE if exp is NULL, or -1 if memory could not be allocated
+static int64_t find_region(struct pack_build_s *b, expr_t exp){
+	if(!exp) return PACK_NONE;
+	for(int i = 1; i < b->region_count; i++){
+		if(b->regions[i].exp == exp) return i;
+	}
+	
+	if(b->region_count >= b->region_max){
+		int max = b->region_max * 2;
+		struct pack_region_s *regions = realloc(b->regions, max * sizeof(struct pack_region_s));
+		if(!regions) return -1;
+		b->regions = regions;
+		b->region_max = max;
+	}
+	int i = b->region_count++;
+	b->regions[i] = (struct pack_region_s){exp, 0, 0, 0, 0};
+	return i;
+}
+
+// Count the nodes, constants, and pointers needed to pack exp adding the regions it references
+// Returns false if exp can't be packed
+static bool count_pack(struct pack_build_s *b, expr_t exp){
+	size_t top = 0;
+	if(!reserve_stack(b, top)) return 0;
+	b->stack[top++].exp = exp;
+	
+	while(top > 0){
+		exp = b->stack[--top].exp;
+		b->nodes++;
+		switch(exp->type){
+			case EXPR_CONST: b->consts++;
+			break;
+			case EXPR_ARGS:
+			break;
+			case EXPR_CACHED: b->ptrs++;
+			break;
+			case EXPR_MEMO:
+				b->ptrs++;
+				if(find_region(b, exp->memo->ref) < 0) return 0;
+			break;
+			
+			case EXPR_VAR:
+				b->ptrs++;
+				if(find_region(b, exp->ref) < 0) return 0;
+			// fall through
+			case EXPR_FUNC1:
+			case EXPR_FUNC2:
+			case EXPR_FUNCN:
+			case EXPR_ADD:
+			case EXPR_MUL:
+			case EXPR_POW:
+				if(exp->child_count > UINT16_MAX) return 0;
+				for(expr_t c = exp->children; c; c = c->next){
+					if(!reserve_stack(b, top)) return 0;
+					b->stack[top++].exp = c;
+				}
+			break;
+			
+			// Used during parsing
+			// But won't occur as types of actual nodes
+			default: return 0;
+		}
+	}
+	return 1;
+}
+
+// Pack exp into the nodes following the ones filled so far
+// MEMO and VAR nodes are given the indices of their regions as roots until every region is placed
+// Returns false if exp can't be packed
+static bool fill_pack(struct pack_build_s *b, expr_t exp){
+	expr_pack_t pk = b->pk;
+	size_t start = b->nodes, top = 0;
+	if(!reserve_stack(b, top)) return 0;
+	b->stack[top++].exp = exp;
+	
+	// Children are pushed first to last so they are packed last to first each right after its parent
+	while(top > 0){
+		exp = b->stack[--top].exp;
+		struct expr_node_s *node = pk->nodes + b->nodes++;
+		node->type = exp->type;
+		node->add_inv = exp->add_inv;
+		node->mul_inv = exp->mul_inv;
+		node->child_count = 0;
+		node->operand = 0;
+		
+		int id;
+		switch(exp->type){
+			case EXPR_CONST:
+				pk->consts[b->consts] = exp->constant;
+				node->operand = b->consts++;
+			break;
+			case EXPR_ARGS: node->operand = exp->arg_ind;
+			break;
+			case EXPR_CACHED:
+				pk->ptrs[b->ptrs] = exp->cache;
+				pk->roots[b->ptrs] = PACK_NONE;
+				node->operand = b->ptrs++;
+			break;
+			case EXPR_MEMO:
+				pk->ptrs[b->ptrs] = exp->memo;
+				pk->roots[b->ptrs] = find_region(b, exp->memo->ref);
+				node->operand = b->ptrs++;
+			break;
+			
+			case EXPR_VAR:
+				pk->ptrs[b->ptrs] = exp->ref;
+				pk->roots[b->ptrs] = find_region(b, exp->ref);
+				node->operand = b->ptrs++;
+			break;
+			case EXPR_FUNC1:
+			case EXPR_FUNC2:
+			case EXPR_FUNCN:
+				if((id = func_id(exp->func)) < 0) return 0;
+				node->operand = id;
+			break;
+			default:
+			break;
+		}
+		
+		if(!is_leaf(exp)){
+			int count = 0;
+			for(expr_t child = exp->children; child && count < exp->child_count; child = child->next, count++){
+				if(!reserve_stack(b, top)) return 0;
+				b->stack[top++].exp = child;
+			}
+			node->child_count = exp->child_count;
+		}
+	}
+	
+	// Sizes are found last to first since the subtrees of the children of each node follow it one after another
+	for(size_t n = b->nodes; n-- > start;){
+		struct expr_node_s *node = pk->nodes + n;
+		uint32_t size = 1;
+		for(int k = 0; k < node->child_count; k++) size += pk->nodes[n + size].size;
+		node->size = size;
+	}
+	return 1;
+}
+
+// Find the stack and calls needed to evaluate the i'th region once the regions it calls are measured
+// Returns the index of a region it calls which isn't measured yet or -1 once the region is measured
+static int measure_region(struct pack_build_s *b, int i){
+	struct pack_region_s *region = b->regions + i;
+	const struct expr_node_s *nodes = b->pk->nodes;
+	
+	uint32_t height = 0, stack = 0, depth = 0;
+	for(uint32_t n = region->root + nodes[region->root].size; n > region->root; ){
+		const struct expr_node_s *node = nodes + --n;
+		if(node->type == EXPR_MEMO || node->type == EXPR_VAR){
+			uint32_t callee = b->pk->roots[node->operand];
+			if(callee != PACK_NONE){
+				if(!(b->regions[callee].measured)) return callee;
+				// Arguments stay below the values of the callee
+				if(height + b->regions[callee].stack > stack) stack = height + b->regions[callee].stack;
+				if(1 + b->regions[callee].depth > depth) depth = 1 + b->regions[callee].depth;
+			}
+		}
+		height = height - node->child_count + 1;
+		if(height > stack) stack = height;
+	}
+	
+	region->stack = stack;
+	region->depth = depth;
+	region->measured = 1;
+	return -1;
+}
+
+// Measure the regions of b starting from the expression itself
+// Regions are measured after those they call without recursing however long the chains of calls are
+static bool measure_regions(struct pack_build_s *b){
+	size_t top = 0;
+	if(!reserve_stack(b, top)) return 0;
+	b->stack[top++].region = 0;
+	
+	while(top > 0){
+		int callee = measure_region(b, b->stack[top - 1].region);
+		if(callee < 0){
+			top--;
+		}else{
+			if(!reserve_stack(b, top)) return 0;
+			b->stack[top++].region = callee;
+		}
+	}
+	return 1;
+}
+
+expr_pack_t expr_pack(expr_t exp, expr_t minus){
+	struct pack_build_s b = {.nodes = minus ? 1 : 0, .regions = malloc(4 * sizeof(struct pack_region_s)), .region_count = 1, .region_max = 4};
+	if(!b.regions) return NULL;
+	b.regions[0] = (struct pack_region_s){NULL, 0, 0, 0, 0};
+	
+	// Regions found while counting are appended and counted in turn
+	bool ok = count_pack(&b, exp) && (!minus || count_pack(&b, minus));
+	for(int i = 1; ok && i < b.region_count; i++) ok = count_pack(&b, b.regions[i].exp);
+	if(!ok || b.nodes >= UINT32_MAX){
+		free(b.regions);
+		free(b.stack);
+		return NULL;
+	}
+	
+	// Constants and pointers go first in the allocation to keep them aligned
+	expr_pack_t pk = malloc(sizeof(struct expr_pack_s) + b.consts * sizeof(double) + b.ptrs * (sizeof(void*) + sizeof(uint32_t)) + b.nodes * sizeof(struct expr_node_s));
+	if(!pk){
+		free(b.regions);
+		free(b.stack);
+		return NULL;
+	}
+	pk->consts = (double*)(pk + 1);
+	pk->ptrs = (void**)(pk->consts + b.consts);
+	pk->roots = (uint32_t*)(pk->ptrs + b.ptrs);
+	pk->nodes = (struct expr_node_s*)(pk->roots + b.ptrs);
+	
+	// Every region was found while counting so they are only looked up while filling
+	b.pk = pk;
+	b.nodes = b.consts = b.ptrs = 0;
+	if(minus){
+		// Difference is the sum of exp and the negation of minus
+		struct expr_node_s *root = pk->nodes + b.nodes++;
+		root->type = EXPR_ADD;
+		root->add_inv = 0;
+		root->mul_inv = 0;
+		root->child_count = 2;
+		root->operand = 0;
+		
+		uint32_t neg = b.nodes;
+		ok = fill_pack(&b, minus) && fill_pack(&b, exp);
+		if(ok) pk->nodes[neg].add_inv = !(pk->nodes[neg].add_inv);
+		root->size = b.nodes;
+	}else{
+		ok = fill_pack(&b, exp);
+	}
+	for(int i = 1; ok && i < b.region_count; i++){
+		b.regions[i].root = b.nodes;
+		ok = fill_pack(&b, b.regions[i].exp);
+	}
+	
+	if(ok) ok = measure_regions(&b);
+	if(ok){
+		pk->stack_size = b.regions[0].stack;
+		pk->call_depth = b.regions[0].depth;
+		
+		// Replace the indices of regions with their roots
+		for(size_t i = 0; i < b.ptrs; i++){
+			if(pk->roots[i] != PACK_NONE) pk->roots[i] = b.regions[pk->roots[i]].root;
+		}
+	}
+	
+	free(b.regions);
+	free(b.stack);
+	if(!ok){
+		free(pk);
+		return NULL;
+	}
+	return pk;
+}
+
+void free_pack(expr_pack_t pk){
+	free(pk);
+}
+
+// Variable or function being evaluated by eval_pack and where to continue once it is done
+struct pack_frame_s{
+	// MEMO or VAR node evaluating it
+	const struct expr_node_s *node;
+	// Next node to evaluate and the root of the region of the caller
+	uint32_t next, stop;
+	// Height of the stack to return to and the arguments of the caller
+	uint32_t base;
+	double *args;
+};
+
+// Stack and calls that fit in locals of eval_pack, larger ones are allocated
+#define PACK_LOCAL_STACK 64
+#define PACK_LOCAL_FRAMES 16
+
+double eval_pack(expr_pack_t pk, double *args, expr_precision_t precision){
+	const union expr_func_u *funcs = precision == EXPR_FAST ? fast_func_ids : func_ids;
+	double local_stack[PACK_LOCAL_STACK];
+	struct pack_frame_s local_frames[PACK_LOCAL_FRAMES];
+	double *stack = local_stack;
+	struct pack_frame_s *frames = local_frames;
+	if(pk->stack_size > PACK_LOCAL_STACK || pk->call_depth > PACK_LOCAL_FRAMES){
+		stack = malloc(pk->stack_size * sizeof(double) + pk->call_depth * sizeof(struct pack_frame_s));
+		if(!stack) return NAN;
+		frames = (struct pack_frame_s*)(stack + pk->stack_size);
+	}
+	
+	const struct expr_node_s *nodes = pk->nodes, *node;
+	uint32_t next = nodes[0].size, stop = 0, sp = 0, root;
+	int fp = 0;
+	double value;
+	for(;;){
+		if(next == stop){
+			// Region is finished with its value on top of the stack
+			if(fp == 0) break;
+			struct pack_frame_s *frame = frames + --fp;
+			value = stack[sp - 1];
+			node = frame->node;
+			if(node->type == EXPR_MEMO){
+				expr_memo_t *memo = pk->ptrs[node->operand];
+				memo->value = value;
+				memo->stamp = expr_memo_epoch;
+			}
+			next = frame->next;
+			stop = frame->stop;
+			sp = frame->base;
+			args = frame->args;
+		}else{
+			node = nodes + --next;
+			stats.evals[node->type]++;
+			
+			// Values of the children in order
+			double *vals = stack + sp - node->child_count;
+			switch(node->type){
+				case EXPR_CONST: value = pk->consts[node->operand];
+				break;
+				case EXPR_ARGS: value = args[node->operand];
+				break;
+				case EXPR_CACHED: value = *(double*)(pk->ptrs[node->operand]);
+				break;
+				case EXPR_MEMO:
+				{
+					expr_memo_t *memo = pk->ptrs[node->operand];
+					root = pk->roots[node->operand];
+					if(memo->stamp == expr_memo_epoch){
+						value = memo->value;
+					}else if(root == PACK_NONE){
+						value = memo->value = 0;
+						memo->stamp = expr_memo_epoch;
+					}else{
+						// Recalculate value since it hasn't been calculated during this epoch
+						frames[fp++] = (struct pack_frame_s){node, next, stop, sp, args};
+						args = NULL;
+						stop = root;
+						next = root + nodes[root].size;
+						continue;
+					}
+				}
+				break;
+				
+				case EXPR_FUNC1: value = funcs[node->operand].one_arg(vals[0]);
+				break;
+				case EXPR_FUNC2: value = funcs[node->operand].two_arg(vals[0], vals[1]);
+				break;
+				case EXPR_FUNCN: value = funcs[node->operand].n_arg(vals);
+				break;
+				
+				case EXPR_ADD:
+					value = -0.0;
+					for(int c = 0; c < node->child_count; c++) value += vals[c];
+				break;
+				case EXPR_MUL:
+					value = 1;
+					for(int c = 0; c < node->child_count; c++) value *= vals[c];
+				break;
+				case EXPR_POW: value = pow(vals[0], vals[1]);
+				break;
+				
+				case EXPR_VAR:
+					root = pk->roots[node->operand];
+					if(root == PACK_NONE){
+						value = 0;
+						break;
+					}
+					// Values of the children stay on the stack as the arguments of the function
+					frames[fp++] = (struct pack_frame_s){node, next, stop, sp - node->child_count, args};
+					args = vals;
+					stop = root;
+					next = root + nodes[root].size;
+				continue;
+				
+				default: value = 0;
+				break;
+			}
+			sp -= node->child_count;
+		}
+		
+		if(node->add_inv) value = -value;
+		if(node->mul_inv) value = 1 / value;
+		stack[sp++] = value;
+	}
+	
+	value = stack[0];
+	if(stack != local_stack) free(stack);
+	return value;
+}
+
 // Check if exp has the same type and relevant parameters as target
 bool expr_match(expr_t exp, expr_t target){
 	// Children are not consider in determining a match only the type and relevant parameters
@@ -204,6 +1462,7 @@ bool expr_match(expr_t exp, expr_t target){
 			case EXPR_CONST: return exp->constant == target->constant;
 			case EXPR_ARGS: return exp->arg_ind == target->arg_ind;
 			case EXPR_CACHED: return exp->cache == target->cache;
+			case EXPR_MEMO: return exp->memo == target->memo;
 			
 			// Check if exp and target refer to the same variable
 			case EXPR_VAR: return exp->ref == target->ref;
@@ -235,7 +1494,7 @@ bool expr_depends(expr_t exp, expr_t target){
 	if(expr_match(exp, target)){
 		// Check if exp and target match
 		return 1;
-	}else if(exp->type == EXPR_CONST || exp->type == EXPR_ARGS || exp->type == EXPR_CACHED){
+	}else if(exp->type == EXPR_CONST || exp->type == EXPR_ARGS || exp->type == EXPR_CACHED || exp->type == EXPR_MEMO){
 		// For any leaf nodes if type doesn't match 
 		return 0;
 	}
@@ -248,6 +1507,72 @@ bool expr_depends(expr_t exp, expr_t target){
 	return 0;
 }
 
+// Degree of exp as a polynomial in var, only distinguishing constant, linear, and other
+int expr_degree(expr_t exp, expr_t var, expr_t coupled){
+	int deg = 0, d;
+	if(expr_match(exp, var)){
+		deg = 1;
+	}else if(coupled && expr_match(exp, coupled)){
+		return -1;
+	}else switch(exp->type){
+		// Leaves which don't match var are constant with respect to it
+		case EXPR_CONST:
+		case EXPR_ARGS:
+		case EXPR_CACHED:
+		break;
+		
+		// Sum is linear when every term is
+		case EXPR_ADD:
+			for(expr_t c = exp->children; c; c = c->next){
+				d = expr_degree(c, var, coupled);
+				if(d < 0) return -1;
+				if(d > deg) deg = d;
+			}
+		break;
+		// Product is linear when only one factor is linear and the rest are constant
+		case EXPR_MUL:
+			for(expr_t c = exp->children; c; c = c->next){
+				d = expr_degree(c, var, coupled);
+				if(d < 0) return -1;
+				deg += d;
+			}
+			if(deg > 1) return -1;
+		break;
+		
+		// Memoized expression is linear if the expression it references is
+		case EXPR_MEMO:
+			deg = expr_degree(exp->memo->ref, var, coupled);
+		break;
+		
+		// Referenced expression may depend on var but only when its arguments don't
+		case EXPR_VAR:
+			for(expr_t c = exp->children; c; c = c->next){
+				if(expr_degree(c, var, coupled) != 0) return -1;
+			}
+			deg = expr_degree(exp->ref, var, coupled);
+		break;
+		
+		// Functions and powers are only linear when constant
+		case EXPR_FUNC1:
+		case EXPR_FUNC2:
+		case EXPR_FUNCN:
+		case EXPR_POW:
+			for(expr_t c = exp->children; c; c = c->next){
+				if(expr_degree(c, var, coupled) != 0) return -1;
+			}
+		break;
+		
+		// Used during parsing
+		// But won't occur as types of actual nodes
+		case EXPR_PARENTH:
+		case EXPR_COMMA:
+		break;
+	}
+	
+	// Reciprocal of anything depending on var isn't linear
+	if(deg > 0 && exp->mul_inv) return -1;
+	return deg;
+}
 
 
 
@@ -288,6 +1613,18 @@ expr_t cached_expr(expr_t exp, double *cache){
 	return exp;
 }
 
+expr_t memo_expr(expr_t exp, expr_memo_t *memo){
+	free_expr_no_self(exp);
+	
+	exp->type = EXPR_MEMO;
+	exp->next = NULL;
+	exp->add_inv = 0;
+	exp->mul_inv = 0;
+	
+	exp->memo = memo;
+	return exp;
+}
+
 // Apply other expressions or functions
 expr_t apply_expr(expr_t exp, expr_t var, int argc, expr_t *args){
 	free_expr_no_self(exp);
@@ -396,7 +1733,8 @@ const char *parse_errstr[] = {
 	"ERR_MISSING_VALUE", "ERR_EMPTY_EXPRESSION", "ERR_TOO_MANY_VALUES",
 	"ERR_BAD_ARITY",
 	"ERR_PARENTH_MISMATCH",
-	"ERR_PARSE_OVERFLOW", "ERR_BAD_EXPRESSION"
+	"ERR_PARSE_OVERFLOW", "ERR_BAD_EXPRESSION",
+	"ERR_CIRCULAR", "ERR_TOO_DEEP"
 };
 
 
@@ -495,10 +1833,18 @@ static struct token_s lex_expr(const char **str, parse_err_t *err){
 
 
 
+// Number of elements of the stacks placed on the call stack
+// Stacks grow onto the heap for longer expressions
 #define PARSE_STACK_SIZE 256
+// Most operators, function calls, and parentheses open at once while parsing
+// Evaluating and rewriting expressions recurses once per level so deeper ones are rejected with ERR_TOO_DEEP
+#define PARSE_MAX_DEPTH 1000
 
 typedef struct{
 	struct expr_s *head, *tail, *ptr;
+	
+	// Indicate that head was allocated on the heap once the stack outgrew its initial buffer
+	bool on_heap;
 } expr_stack_t;
 
 // Pop off top element from stack
@@ -544,10 +1890,31 @@ static struct expr_s *peek(expr_stack_t *s){
 	return s->ptr->type == EXPR_PARENTH ? NULL : s->ptr;
 }
 
+// Double the space of the stack
+// Pointers to elements of the stack are invalidated
+static bool grow(expr_stack_t *s){
+	size_t size = s->tail - s->head, top = s->ptr ? s->ptr - s->head : 0;
+	struct expr_s *head;
+	if(s->on_heap){
+		head = realloc(s->head, 2 * size * sizeof(struct expr_s));
+	}else{
+		head = malloc(2 * size * sizeof(struct expr_s));
+		if(head) memcpy(head, s->head, size * sizeof(struct expr_s));
+	}
+	if(!head) return 0;
+	
+	s->head = head;
+	s->tail = head + 2 * size;
+	if(s->ptr) s->ptr = head + top;
+	s->on_heap = 1;
+	return 1;
+}
+
 // Place expression on the top of the stack
+// Returns NULL if there is no space and the stack can't grow
 static struct expr_s *push(expr_stack_t *s, struct expr_s exp){
 	// Check if space available
-	if(s->ptr == s->tail) return NULL;
+	if(s->ptr && s->ptr + 1 == s->tail && !grow(s)) return NULL;
 	
 	if(!(s->ptr)){
 	// If no values stored put ptr at head
@@ -627,38 +1994,34 @@ static parse_err_t apply_op(expr_stack_t *s, struct expr_s op){
 			
 			tmp = pop(s);
 			
-			// Count number of arguments to sum
-			cnt = 0;
-			// Include the first element
-			cnt++;
-			if(tmp.type == op.type){
+			// Sums and products which aren't inverted are flattened into op
+			if(tmp.type == op.type && !tmp.add_inv && !tmp.mul_inv){
 				if(!(tmp.children)) return ERR_BAD_EXPRESSION;
 				
 				// Include children of tmp in sum / product
 				op.children = tmp.children;
+				cnt = tmp.child_count;
 				
-				// Move tmp_p to end of children of tmp
 				// Use tmp_p to store tail of op's children
-				for(tmp_p = tmp.children; tmp_p->next; tmp_p = tmp_p->next){
-					cnt++;
-				}
+				tmp_p = tmp.last;
 			}else{
 				// Create space on heap for tmp and make first child
 				op.children = malloc(sizeof(struct expr_s));
 				*(op.children) = tmp;
+				cnt = 1;
 				
 				// Use tmp to store tail of op's children
 				tmp_p = op.children;
 			}
 			
-			// Include the first element
-			if(tmp2.type == op.type){
+			// Include the second element
+			if(tmp2.type == op.type && !tmp2.add_inv && !tmp2.mul_inv){
 				if(!(tmp2.children)) return ERR_BAD_EXPRESSION;
 				
 				// Include children of tmp2 in sum / product
 				tmp_p->next = tmp2.children;
 				
-				for(tmp_p = tmp2.children; tmp_p; tmp_p = tmp_p->next){
+				for(tmp_p = tmp2.children; ; tmp_p = tmp_p->next){
 					// Invert tmp2's children if operator is '-' or '/'
 					if(op.type == EXPR_ADD)
 						tmp_p->add_inv = tmp_p->add_inv ^ op.add_inv;
@@ -667,6 +2030,7 @@ static parse_err_t apply_op(expr_stack_t *s, struct expr_s op){
 					
 					// Count arguments from tmp2
 					cnt++;
+					if(!(tmp_p->next)) break;
 				}
 			}else{
 				cnt++;
@@ -680,11 +2044,13 @@ static parse_err_t apply_op(expr_stack_t *s, struct expr_s op){
 				// Create space on heap for tmp2 and store at tail of sum
 				tmp_p->next = malloc(sizeof(struct expr_s));
 				*(tmp_p->next) = tmp2;
+				tmp_p = tmp_p->next;
 			}
 			
 			op.add_inv = 0;
 			op.mul_inv = 0;
 			op.child_count = cnt;
+			op.last = tmp_p;
 			push(s, op);
 		break;
 		case EXPR_POW:
@@ -713,6 +2079,7 @@ static parse_err_t apply_op(expr_stack_t *s, struct expr_s op){
 		case EXPR_CONST:
 		case EXPR_ARGS:
 		case EXPR_CACHED:
+		case EXPR_MEMO:
 		case EXPR_PARENTH:
 		break;
 	}
@@ -765,9 +2132,11 @@ expr_t parse_expr(const char *src, name_trans_f callback, const char **endptr, p
 	vals.head = val_stack;
 	vals.tail = val_stack + PARSE_STACK_SIZE;
 	vals.ptr = NULL;
+	vals.on_heap = 0;
 	ops.head = op_stack;
 	ops.tail = op_stack + PARSE_STACK_SIZE;
 	ops.ptr = NULL;
+	ops.on_heap = 0;
 	
 	struct expr_s tmp;
 	int prec1, prec2;
@@ -792,32 +2161,28 @@ expr_t parse_expr(const char *src, name_trans_f callback, const char **endptr, p
 				tmp.type = EXPR_PARENTH;
 				
 				// Check builtin functions
-				for(int i = 0; expr_builtin_funcs[i].name[0] != '\0'; i++){
-					if(expr_strnlen(expr_builtin_funcs[i].name, EXPR_FUNCNAME_LEN) == tok.length
-					&& strncasecmp(tok.name, expr_builtin_funcs[i].name, tok.length) == 0
+				const expr_builtin_t *builtin = expr_find_builtin(tok.name, tok.length);
+				if(builtin){
+					tmp.child_count = builtin->arity;
+					
+					// Assign type to function 
+					if(tmp.child_count == 0){
+						tmp.type = EXPR_CONST;
+					}else if((tmp.child_count == 1 || tmp.child_count == 2)
+					&& !(builtin->use_n_arg)
 					){
-						tmp.child_count = expr_builtin_funcs[i].arity;
-							
-						// Assign type to function 
-						if(tmp.child_count == 0){
-							tmp.type = EXPR_CONST;
-						}else if((tmp.child_count == 1 || tmp.child_count == 2)
-						&& !(expr_builtin_funcs[i].use_n_arg)
-						){
-							tmp.type = tmp.child_count == 1 ? EXPR_FUNC1 : EXPR_FUNC2;
-						}else{
-							tmp.type = EXPR_FUNCN;
-						}
-						
-						if(tmp.child_count > 0){
-							// If function with arguments provide pointer
-							tmp.func = expr_builtin_funcs[i].func;
-							tmp.children = NULL;
-						}else{
-							// If constant set constant
-							tmp.constant = expr_builtin_funcs[i].value;
-						}
-						break;
+						tmp.type = tmp.child_count == 1 ? EXPR_FUNC1 : EXPR_FUNC2;
+					}else{
+						tmp.type = EXPR_FUNCN;
+					}
+					
+					if(tmp.child_count > 0){
+						// If function with arguments provide pointer
+						tmp.func = builtin->func;
+						tmp.children = NULL;
+					}else{
+						// If constant set constant
+						tmp.constant = builtin->value;
 					}
 				}
 				
@@ -833,6 +2198,7 @@ expr_t parse_expr(const char *src, name_trans_f callback, const char **endptr, p
 				if(tmp.type == EXPR_CONST
 				|| tmp.type == EXPR_ARGS
 				|| tmp.type == EXPR_CACHED
+				|| tmp.type == EXPR_MEMO
 				|| ((tmp.type == EXPR_VAR || tmp.type == EXPR_FUNCN)
 				   && tmp.child_count == 0)
 				){
@@ -947,6 +2313,9 @@ expr_t parse_expr(const char *src, name_trans_f callback, const char **endptr, p
 			break;
 		}
 		
+		// Operators wait on the stack until their operands are complete so its height is the nesting depth
+		if(*err == ERR_OK && ops.ptr && ops.ptr - ops.head >= PARSE_MAX_DEPTH) *err = ERR_TOO_DEEP;
+		
 		// Break if error occurs during switch
 		if(*err != ERR_OK){
 			break;
@@ -989,6 +2358,9 @@ expr_t parse_expr(const char *src, name_trans_f callback, const char **endptr, p
 		for(s = vals.head; s <= vals.ptr; s++) free_expr_no_self(s);
 	}
 	
+	if(ops.on_heap) free(ops.head);
+	if(vals.on_heap) free(vals.head);
+	
 	if(*err == ERR_OK){
 		// Allocate heap memory for tmp
 		s = malloc(sizeof(struct expr_s));
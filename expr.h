@@ -1,6 +1,7 @@
 #ifndef _EXPR_H
 #define _EXPR_H
 
+#include <stdio.h>
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -15,12 +16,40 @@ void free_expr(expr_t exp);
 // Evaluate value of expression using given arguments in place of args
 double eval_expr(expr_t exp, double *args);
 
+// Number of types of nodes whose evaluations are counted (see stats.h)
+#define EXPR_TYPE_COUNT 13
+// Name of each type of node
+extern const char *expr_type_names[EXPR_TYPE_COUNT];
+
 // Replace expressions only dependent on constants by constants
 expr_t constify_expr(expr_t exp);
+// Rewrite exp in place so it takes fewer operations to evaluate, keeping the root node at the same address
+// Inlines calls to small functions, folds constants, merges sums and products,
+// expands integer powers, and puts polynomials in Horner's form
+expr_t simplify_expr(expr_t exp);
+// Subexpression moved out of an expression by expr_hoist so that it can be evaluated less often
+typedef struct{
+	// Node of the expression which evaluates to value in place of the subexpression
+	expr_t node;
+	// Subexpression that was moved out, whose value must be stored in value before the expression is evaluated
+	expr_t hoisted;
+	double value;
+} expr_hoist_t;
+
+// Move the largest subexpressions of exp which don't read any of the n values pointed to by varying
+// (directly or through the variables and functions they reference) out into hoists
+// Returns the number of hoists written, which is at most max
+int expr_hoist(expr_t exp, double *const *varying, int n, expr_hoist_t *hoists, int max);
+// Move the count subexpressions of hoists back into their expressions
+void expr_unhoist(expr_hoist_t *hoists, int count);
 // Check if exp has the same type and relevant parameters as target
 bool expr_match(expr_t exp, expr_t target);
 // Check if exp contains any expression with the same type and relevant parameters as target
 bool expr_depends(expr_t exp, expr_t target);
+// Degree of exp as a polynomial in the expression var (matched using expr_match)
+// Returns 0 if exp doesn't depend on var, 1 if exp is linear in var, and -1 otherwise
+// Any expression matching coupled (if non-null) is treated as a non-linear function of var
+int expr_degree(expr_t exp, expr_t var, expr_t coupled);
 
 
 // Builtin function of any arity
@@ -30,6 +59,20 @@ union expr_func_u{
 	double (*n_arg)(double*);
 };
 
+// Value of an expression without arguments which is only recalculated once per epoch
+// Allows the value of a variable to be shared between every expression that references it
+typedef struct{
+	// Expression to evaluate
+	expr_t ref;
+	// Last value calculated and the value of expr_memo_epoch when it was calculated
+	double value;
+	unsigned long stamp;
+} expr_memo_t;
+
+// Incrementing the epoch causes all memoized values to be recalculated on their next use
+// Should be incremented whenever a value referenced by EXPR_CACHED changes
+extern unsigned long expr_memo_epoch;
+
 // Constructors for certain expressions
 // Any children that exp may have before the call will be deallocated
 // Creates an expression with a constant value of c
@@ -38,6 +81,8 @@ expr_t const_expr(expr_t exp, double c);
 expr_t arg_expr(expr_t exp, int arg_ind);
 // Creates an expression that will evaluate to the value of *cache
 expr_t cached_expr(expr_t exp, double *cache);
+// Creates an expression that will evaluate to memo->ref calculating it at most once per epoch
+expr_t memo_expr(expr_t exp, expr_memo_t *memo);
 
 // Apply other expressions or functions
 expr_t apply_expr(expr_t exp, expr_t var, int argc, expr_t *args);
@@ -75,9 +120,71 @@ typedef struct{
 		// Constant for 0-arity entries
 		double value;
 	};
+	// Faster approximation of func used while drawing (see expr_fast.h), NULL if func is used for both
+	union expr_func_u fast;
 } expr_builtin_t;
 
 extern expr_builtin_t expr_builtin_funcs[];
+// Find the builtin named by the n characters of name ignoring case
+// Returns NULL if there is no such builtin
+const expr_builtin_t *expr_find_builtin(const char *name, size_t n);
+
+// Precision of the builtin functions called while evaluating
+typedef enum{
+	// Math library functions, used for intersections and printed values
+	EXPR_PRECISE,
+	// Faster approximations with a small absolute error and the same sign, used for drawing
+	EXPR_FAST
+} expr_precision_t;
+// Function of the builtin that fn belongs to in the given precision
+// Returns fn itself if it isn't a builtin with a faster approximation
+union expr_func_u expr_builtin_variant(union expr_func_u fn, expr_precision_t precision);
+// Bind the builtins called by exp to their functions in the given precision
+// Variables and functions referenced are left alone since they are bound through their own expressions
+void expr_set_precision(expr_t exp, expr_precision_t precision);
+
+// Expression packed by expr_pack into a single array of fixed size nodes for faster evaluation
+struct expr_pack_s;
+typedef struct expr_pack_s *expr_pack_t;
+
+// Most distinct builtin functions that packed expressions can call
+#define EXPR_MAX_FUNC_IDS 64
+
+// Pack exp - minus (or only exp if minus is NULL) into one allocation
+// The variables and functions referenced are packed along with it, so it must be packed again when they change
+// Their memos and the caches read are referenced and must outlive the pack
+// Returns NULL if memory could not be allocated or exp can't be packed
+expr_pack_t expr_pack(expr_t exp, expr_t minus);
+// Evaluate a packed expression like eval_expr calling builtins in the given precision
+// Nodes are evaluated in a loop with a stack of values sized when packing rather than by recursion
+double eval_pack(expr_pack_t pk, double *args, expr_precision_t precision);
+void free_pack(expr_pack_t pk);
+
+// Context for writing expressions as C source with expr_emit
+// The C code reads the graph parameters as variables, calls memoized variables as m<i>(x, y, r),
+// calls functions defined by other expressions as f<i>(x, y, r, args), and reads arguments from the array a
+typedef struct{
+	// Values read through EXPR_CACHED and the names of the C variables they are written as
+	double *const *caches;
+	const char *const *cache_names;
+	int cache_count;
+	
+	// Builtins without an equivalent in the C library are called through the pointers fn[i]
+	// which are collected into funcs, holding at most max_funcs
+	union expr_func_u *funcs;
+	int func_count, max_funcs;
+	
+	// Memoized variables and functions referenced, collected for the caller to write as C functions
+	// m<i> evaluates memos[i]->ref and f<i> evaluates refs[i]
+	expr_memo_t **memos;
+	int memo_count, max_memos;
+	expr_t *refs;
+	int ref_count, max_refs;
+} expr_emit_t;
+
+// Write exp to fp as a C expression which evaluates to the same value
+// Returns false if a table of ctx is full or exp reads a value that isn't in caches
+bool expr_emit(FILE *fp, expr_t exp, expr_emit_t *ctx);
 
 // Redefinition and Reimplementation to avoid dependence on novel library functions
 size_t expr_strnlen(const char *s, size_t max);
@@ -93,7 +200,8 @@ typedef enum {
 	ERR_MISSING_VALUE, ERR_EMPTY_EXPRESSION, ERR_TOO_MANY_VALUES,
 	ERR_BAD_ARITY,
 	ERR_PARENTH_MISMATCH,
-	ERR_PARSE_OVERFLOW, ERR_BAD_EXPRESSION
+	ERR_PARSE_OVERFLOW, ERR_BAD_EXPRESSION,
+	ERR_CIRCULAR, ERR_TOO_DEEP
 } parse_err_t;
 // Allow for conversion from enum to string when printing error
 extern const char *parse_errstr[];
@@ -1,6 +1,9 @@
 #include <math.h>
+#include <ctype.h>
 
 #include "expr.h"
+#include "expr_fast.h"
+#include "symtab.h"
 
 // Provide definitions for functions not provided in math.h
 static double sec(double x){
@@ -16,35 +19,67 @@ static double cot(double x){
 }
 
 expr_builtin_t expr_builtin_funcs[] = {
-//  Name, arity, use_n_arg, pointer / constant
-	{"pi",    0, 0, {value: 3.14159265358979323846}},
-	{"e",     0, 0, {value: 2.71828182845904523536}},
-	{"sqrt",  1, 0, {{one_arg: sqrt}}},
-	{"cbrt",  1, 0, {{one_arg: cbrt}}},
-	
-	{"exp",   1, 0, {{one_arg: exp}}},
-	{"ln",    1, 0, {{one_arg: log}}},
-	{"log10", 1, 0, {{one_arg: log10}}},
-	
-	{"sin",   1, 0, {{one_arg: sin}}},
-	{"cos",   1, 0, {{one_arg: cos}}},
-	{"tan",   1, 0, {{one_arg: tan}}},
-	
-	{"sec",   1, 0, {{one_arg: sec}}},
-	{"csc",   1, 0, {{one_arg: csc}}},
-	{"cot",   1, 0, {{one_arg: cot}}},
-	
-	{"sinh",  1, 0, {{one_arg: sinh}}},
-	{"cosh",  1, 0, {{one_arg: cosh}}},
-	{"tanh",  1, 0, {{one_arg: tanh}}},
-	
-	{"asin",  1, 0, {{one_arg: asin}}},
-	{"acos",  1, 0, {{one_arg: acos}}},
-	{"atan",  1, 0, {{one_arg: atan}}},
-	{"atan2", 2, 0, {{two_arg: atan2}}},
-	
-	{"abs",   1, 0, {{one_arg: fabs}}},
-	{"ceil",  1, 0, {{one_arg: ceil}}},
-	{"floor", 1, 0, {{one_arg: floor}}},
+//  Name, arity, use_n_arg, pointer / constant, fast pointer
+	{"pi",    0, 0, {value: 3.14159265358979323846}, {one_arg: NULL}},
+	{"e",     0, 0, {value: 2.71828182845904523536}, {one_arg: NULL}},
+	{"sqrt",  1, 0, {{one_arg: sqrt}}, {one_arg: NULL}},
+	{"cbrt",  1, 0, {{one_arg: cbrt}}, {one_arg: NULL}},
+	
+	{"exp",   1, 0, {{one_arg: exp}},  {one_arg: NULL}},
+	{"ln",    1, 0, {{one_arg: log}},  {one_arg: NULL}},
+	{"log10", 1, 0, {{one_arg: log10}}, {one_arg: NULL}},
+	
+	{"sin",   1, 0, {{one_arg: sin}},  {one_arg: fast_sin}},
+	{"cos",   1, 0, {{one_arg: cos}},  {one_arg: fast_cos}},
+	{"tan",   1, 0, {{one_arg: tan}},  {one_arg: fast_tan}},
+	
+	{"sec",   1, 0, {{one_arg: sec}},  {one_arg: fast_sec}},
+	{"csc",   1, 0, {{one_arg: csc}},  {one_arg: fast_csc}},
+	{"cot",   1, 0, {{one_arg: cot}},  {one_arg: fast_cot}},
+	
+	{"sinh",  1, 0, {{one_arg: sinh}}, {one_arg: fast_sinh}},
+	{"cosh",  1, 0, {{one_arg: cosh}}, {one_arg: NULL}},
+	{"tanh",  1, 0, {{one_arg: tanh}}, {one_arg: fast_tanh}},
+	
+	{"asin",  1, 0, {{one_arg: asin}}, {one_arg: NULL}},
+	{"acos",  1, 0, {{one_arg: acos}}, {one_arg: NULL}},
+	{"atan",  1, 0, {{one_arg: atan}}, {one_arg: NULL}},
+	{"atan2", 2, 0, {{two_arg: atan2}}, {one_arg: NULL}},
+	
+	{"abs",   1, 0, {{one_arg: fabs}}, {one_arg: NULL}},
+	{"ceil",  1, 0, {{one_arg: ceil}}, {one_arg: NULL}},
+	{"floor", 1, 0, {{one_arg: floor}}, {one_arg: NULL}},
 	{}
 };
+
+
+// Builtins hashed by name, built on the first lookup
+static symtab_t builtins;
+
+const expr_builtin_t *expr_find_builtin(const char *name, size_t n){
+	// Names of builtins are lowercase so compare against the lowercase name
+	char lower[EXPR_FUNCNAME_LEN];
+	if(n >= EXPR_FUNCNAME_LEN) return NULL;
+	for(size_t i = 0; i < n; i++) lower[i] = tolower((unsigned char)name[i]);
+	
+	if(builtins.count == 0){
+		for(int i = 0; expr_builtin_funcs[i].name[0] != '\0'; i++){
+			const char *s = expr_builtin_funcs[i].name;
+			symtab_add(&builtins, s, expr_strnlen(s, EXPR_FUNCNAME_LEN), expr_builtin_funcs + i);
+		}
+	}
+	
+	struct sym_s *sym = symtab_find(&builtins, lower, n);
+	return sym ? sym->value : NULL;
+}
+
+union expr_func_u expr_builtin_variant(union expr_func_u fn, expr_precision_t precision){
+	for(int i = 0; expr_builtin_funcs[i].name[0] != '\0'; i++){
+		const expr_builtin_t *builtin = expr_builtin_funcs + i;
+		if(builtin->arity == 0 || !(builtin->fast.n_arg)) continue;
+		if(builtin->func.n_arg == fn.n_arg || builtin->fast.n_arg == fn.n_arg){
+			return precision == EXPR_FAST ? builtin->fast : builtin->func;
+		}
+	}
+	return fn;
+}
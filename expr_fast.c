@@ -0,0 +1,116 @@
+#include <math.h>
+
+#include "expr_fast.h"
+
+// Angles larger than this are reduced by the math library
+#define TRIG_MAX 1e5
+// Adding then subtracting 1.5 * 2^52 rounds a double below 2^51 to the nearest integer
+#define ROUND_MAGIC 0x1.8p52
+
+static const double two_over_pi = 6.36619772367581382433e-01;
+// pi/2 split into parts short enough that their products with the quadrant are exact (from fdlibm)
+static const double pio2_1 = 1.57079632673412561417e+00, pio2_2 = 6.07710050630396597660e-11, pio2_3 = 2.02226624871116645580e-21;
+
+// Minimax coefficients of sin and cos over [-pi/4, pi/4] (from fdlibm)
+static const double S1 = -1.66666666666666324348e-01, S2 = 8.33333333332248946124e-03, S3 = -1.98412698298579493134e-04,
+	S4 = 2.75573137070700676789e-06, S5 = -2.50507602534068634195e-08, S6 = 1.58969099521155010221e-10;
+static const double C1 = 4.16666666666666019037e-02, C2 = -1.38888888888741095749e-03, C3 = 2.48015872894767294178e-05,
+	C4 = -2.75573143513906633035e-07, C5 = 2.08757232129817482790e-09, C6 = -1.13596475577881948265e-11;
+
+// Reduce x to r within [-pi/4, pi/4] returning the quadrant of x
+static inline int reduce_trig(double x, double *r){
+	double n = (x * two_over_pi + ROUND_MAGIC) - ROUND_MAGIC;
+	*r = ((x - n * pio2_1) - n * pio2_2) - n * pio2_3;
+	return (int)n;
+}
+
+// Polynomials are evaluated in pairs of terms (Estrin's scheme) so fewer of the operations depend on each other
+
+static inline double sin_kernel(double r){
+	// Zero is returned as is to keep its sign
+	if(r == 0) return r;
+	double z = r * r, w = z * z;
+	return r + r * z * ((S1 + z * S2) + w * ((S3 + z * S4) + w * (S5 + z * S6)));
+}
+
+static inline double cos_kernel(double r){
+	double z = r * r, w = z * z;
+	return 1 - 0.5 * z + w * ((C1 + z * C2) + w * ((C3 + z * C4) + w * (C5 + z * C6)));
+}
+
+// Both kernels are evaluated and the quadrant selects between them
+// since the quadrants of neighboring samples are too irregular for branches to predict
+// sin(x) is +-sin(r) or +-cos(r) for quadrants 0 to 3 in turn
+static inline double quadrant_sin(int q, double r){
+	double s = sin_kernel(r), c = cos_kernel(r);
+	double v = q & 1 ? c : s;
+	return q & 2 ? -v : v;
+}
+
+double fast_sin(double x){
+	if(!(fabs(x) < TRIG_MAX)) return sin(x);
+	double r;
+	int q = reduce_trig(x, &r);
+	return quadrant_sin(q, r);
+}
+
+double fast_cos(double x){
+	if(!(fabs(x) < TRIG_MAX)) return cos(x);
+	// cos(x) = sin(x + pi/2) which is one quadrant further
+	double r;
+	int q = reduce_trig(x, &r);
+	return quadrant_sin(q + 1, r);
+}
+
+double fast_tan(double x){
+	if(!(fabs(x) < TRIG_MAX)) return tan(x);
+	double r;
+	int q = reduce_trig(x, &r);
+	// Shifting by a quarter turn turns sin / cos into -cos / sin
+	double s = sin_kernel(r), c = cos_kernel(r);
+	return q & 1 ? -c / s : s / c;
+}
+
+double fast_sec(double x){
+	return 1 / fast_cos(x);
+}
+
+double fast_csc(double x){
+	return 1 / fast_sin(x);
+}
+
+double fast_cot(double x){
+	if(!(fabs(x) < TRIG_MAX)) return cos(x) / sin(x);
+	double r;
+	int q = reduce_trig(x, &r);
+	double s = sin_kernel(r), c = cos_kernel(r);
+	return q & 1 ? -s / c : c / s;
+}
+
+
+
+double fast_sinh(double x){
+	double a = fabs(x);
+	// Taylor series near 0 where the exponentials would cancel
+	if(a < 0.5){
+		double z = x * x;
+		return x + x * z * (1.0 / 6 + z * (1.0 / 120 + z * (1.0 / 5040 + z * (1.0 / 362880
+			+ z * (1.0 / 39916800 + z * (1.0 / 6227020800))))));
+	}
+	if(!(a < 700)) return sinh(x);
+	
+	double e = exp(a);
+	return copysign(0.5 * (e - 1 / e), x);
+}
+
+double fast_tanh(double x){
+	double a = fabs(x);
+	if(a < 0.5){
+		double s = fast_sinh(x);
+		return s / sqrt(1 + s * s);
+	}
+	// tanh has rounded to +-1 well before 22 so those along with NaN are left to the math library
+	if(!(a <= 22)) return tanh(x);
+	
+	return copysign(1 - 2 / (exp(2 * a) + 1), x);
+}
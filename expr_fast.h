@@ -0,0 +1,23 @@
+#ifndef _EXPR_FAST_H
+#define _EXPR_FAST_H
+
+/* Faster versions of the math library functions bound to the trigonometric and hyperbolic builtins (see expr_builtins.c)
+ * Used while drawing where only the sign of an equation near its zeros matters
+ *
+ * Angles are reduced with a few multiplies and fixed polynomials evaluated without the special cases of the math library
+ * Results have a small absolute error and the same sign as the math library, but no bound in ULP holds:
+ * near zeros of the functions (e.g. multiples of pi/2 for large angles) the relative error can be large
+ * Arguments outside of the ranges handled (e.g. huge angles, infinities, NaN) are passed on to the math library
+ */
+
+double fast_sin(double x);
+double fast_cos(double x);
+double fast_tan(double x);
+double fast_sec(double x);
+double fast_csc(double x);
+double fast_cot(double x);
+
+double fast_sinh(double x);
+double fast_tanh(double x);
+
+#endif
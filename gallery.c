@@ -4,9 +4,16 @@
 #include <ctype.h>
 
 #include "gallery.h"
+#include "stats.h"
+#include "trace.h"
 
 // Locations to place x, y, and redius values for evaluation of expressions
 static double xref, yref, rref;
+// Precision of the builtins eval_equat calls, fast only while draw_curves is drawing
+static expr_precision_t precision = EXPR_PRECISE;
+
+// Most subexpressions hoisted out of the rows (or columns) of the lattice by sample_equats
+#define SAMPLE_HOIST_MAX 32
 
 // List of arguments for variable
 static struct arg_s{
@@ -16,13 +23,60 @@ static struct arg_s{
 	struct arg_s *next;
 } *arguments;
 
+// Names of the variables in the gallery
+static symtab_t variables;
+
+// Equation whose references are being recorded while it is parsed
+static equat_t parsing;
+
+
+// Add eq to list unless it is already in it
+// Returns whether eq was added
+static bool list_add(struct equat_list_s *list, equat_t eq){
+	for(int i = 0; i < list->count; i++) if(list->items[i] == eq) return 0;
+	
+	if(list->count == list->cap){
+		int cap = list->cap ? 2 * list->cap : 4;
+		equat_t *items = realloc(list->items, cap * sizeof(equat_t));
+		if(!items) return 0;
+		list->items = items;
+		list->cap = cap;
+	}
+	list->items[list->count++] = eq;
+	return 1;
+}
+
+// Remove eq from list if it is in it
+static void list_remove(struct equat_list_s *list, equat_t eq){
+	for(int i = 0; i < list->count; i++){
+		if(list->items[i] == eq){
+			// Order of the edges doesn't matter so fill the gap with the last one
+			list->items[i] = list->items[--(list->count)];
+			return;
+		}
+	}
+}
+
+// Record that user references the variable dep
+static void add_dep(equat_t user, equat_t dep){
+	if(list_add(&(user->deps), dep)) list_add(&(dep->users), user);
+}
+
+// Remove the edges from eq to the variables it references
+static void clear_deps(equat_t eq){
+	for(int i = 0; i < eq->deps.count; i++) list_remove(&(eq->deps.items[i]->users), eq);
+	eq->deps.count = 0;
+}
+
+
 // Functions to parse and evaluate equations
 static expr_t translate_name(expr_t exp, const char *name, size_t n, void *inp){
+	(void)inp;  // Names are looked up in the static tables of the gallery
 	if(arguments){
 		// Check argument list first if present
 		int i = 0;
 		for(struct arg_s *arg = arguments; arg; arg = arg->next){
-			if(arg->name && strncmp(arg->name, name, arg->length < n ? arg->length : n) == 0){
+			if(arg->name && arg->length == n && strncmp(arg->name, name, n) == 0){
 				return arg_expr(exp, i);
 			}
 			i++;
@@ -38,59 +92,323 @@ static expr_t translate_name(expr_t exp, const char *name, size_t n, void *inp){
 		}
 	}
 	
-	// Finally check gallery for variable names that match
-	// inp -> head of list of equations
-	for(equat_t eq = inp; eq; eq = eq->next){
-		if(eq->is_variable // Only consider equations that represent variables
-		&& eq->name
-		&& strncmp(eq->name, name, eq->name_len < n ? eq->name_len : n) == 0
-		&& eq->right  // Ensure variable has expression
-		){
-			return apply_expr(exp, eq->right, eq->arity, NULL);
-		}
+	// Finally check the names of the variables in the gallery
+	struct sym_s *found = symtab_find(&variables, name, n);
+	for(struct sym_s *sym = found; sym; sym = symtab_next(sym)){
+		equat_t eq = sym->value;
+		
+		// Record the reference even when the variable has no expression
+		// so the equation is reparsed once the variable is fixed
+		if(parsing) add_dep(parsing, eq);
+		if(!(eq->right)) continue;  // Ensure variable has expression
+		
+		// Variables without arguments share a memoized value between their references
+		if(eq->arity == 0) return memo_expr(exp, &(eq->memo));
+		return apply_expr(exp, eq->right, eq->arity, NULL);
 	}
+	
 	return NULL;
 }
 
+double *equat_param(char name){
+	switch(name){
+		case 'x': return &xref;
+		case 'y': return &yref;
+		case 'r': return &rref;
+		default: return NULL;
+	}
+}
+
 // Function passed to graph to draw curve
 double eval_equat(void *inp, double x, double y){
 	equat_t eq = inp;
+	if(eq->native) return eq->native(x, y);
+	
 	xref = x;
 	yref = y;
 	rref = hypot(x, y);
+	expr_memo_epoch++;  // Memoized variables depend on the new point
 	
+	if(eq->packed) return eval_pack(eq->packed, NULL, precision);
 	return eval_expr(eq->left, NULL) - eval_expr(eq->right, NULL);
 }
 
+// Function passed to graph to draw equation as a function
+double solve_equat(void *inp, double t){
+	equat_t eq = inp;
+	double f0, fs, s;
+	
+	// Equation is linear in the unknown u and so has the form a * u + b = 0
+	// Evaluate at u = 0 to obtain b
+	f0 = eq->solve == SOLVE_X ? eval_equat(eq, 0, t) : eval_equat(eq, t, 0);
+	// Evaluate at u = s to obtain a, using a step proportional to b to avoid cancellation
+	s = fabs(f0) > 1 ? fabs(f0) : 1;
+	fs = eq->solve == SOLVE_X ? eval_equat(eq, s, t) : eval_equat(eq, t, s);
+	
+	// u = -b / a
+	return f0 * s / (f0 - fs);
+}
+
+// Add secs to the time spent drawing eq in the last redraw and in total
+static void add_draw_time(equat_t eq, double secs){
+	eq->draw_time += secs;
+	eq->draw_total += secs;
+}
+
+// Sample signs of equations at every point of the lattice described by rect
+void sample_equats(signgrid_t *sg, struct bound_s rect, equat_t *eqs, int count){
+	if(!signgrid_reset(sg, rect, count)) return;
+	sg->approximate = precision == EXPR_FAST;
+	for(int k = 0; k < count; k++) sg->inputs[k] = eqs[k];
+	if(count == 0) return;
+	trace_begin("sample_equats", NULL);
+	
+	// Calculate x values of the columns once for all rows
+	// Points are stepped to like in curve_inters so the signs match its lattice exactly
+	int rowlen = rect.columns + 1;
+	double *xs = malloc(rowlen * sizeof(double));
+	double cwid = rect.width / rect.columns, chei = rect.height / rect.rows;
+	double px = rect.x, py = rect.y;
+	for(int x = 0; x < rowlen; x++, px += cwid) xs[x] = px;
+	
+	// Parts of the equations only depending on x are hoisted out of the rows and evaluated once per column,
+	// then the parts only depending on y (which can't read the x parts) are hoisted out and evaluated once per row
+	expr_hoist_t xhoists[SAMPLE_HOIST_MAX], yhoists[SAMPLE_HOIST_MAX];
+	double *varying[2 + SAMPLE_HOIST_MAX] = {&yref, &rref};
+	int xcount = 0, ycount = 0;
+	for(int k = 0; k < count; k++){
+		if(eqs[k]->native_row) continue;
+		xcount += expr_hoist(eqs[k]->left, varying, 2, xhoists + xcount, SAMPLE_HOIST_MAX - xcount);
+		xcount += expr_hoist(eqs[k]->right, varying, 2, xhoists + xcount, SAMPLE_HOIST_MAX - xcount);
+	}
+	varying[0] = &xref;
+	for(int i = 0; i < xcount; i++) varying[2 + i] = &(xhoists[i].value);
+	for(int k = 0; k < count; k++){
+		if(eqs[k]->native_row) continue;
+		ycount += expr_hoist(eqs[k]->left, varying, 2 + xcount, yhoists + ycount, SAMPLE_HOIST_MAX - ycount);
+		ycount += expr_hoist(eqs[k]->right, varying, 2 + xcount, yhoists + ycount, SAMPLE_HOIST_MAX - ycount);
+	}
+	
+	// Compiled equations are evaluated a row at a time into rowvals instead
+	int interpreted = 0;
+	for(int k = 0; k < count; k++) interpreted += !(eqs[k]->native_row);
+	double *rowvals = interpreted < count ? malloc(rowlen * sizeof(double)) : NULL;
+	
+	double *xvals = malloc((xcount > 0 ? xcount * rowlen : 1) * sizeof(double));
+	yref = rect.y;
+	for(int x = 0; x < rowlen; x++){
+		xref = xs[x];
+		rref = hypot(xref, yref);
+		expr_memo_epoch++;
+		for(int i = 0; i < xcount; i++) xvals[x * xcount + i] = eval_expr(xhoists[i].hoisted, NULL);
+	}
+	
+	// When timing, the evaluations of each equation are counted to divide the time between them
+	// since the shared point and memoized variables keep them from being timed separately
+	unsigned long *work = stats_enabled ? calloc(count, sizeof(unsigned long)) : NULL;
+	double start = work ? stats_now() : 0, native_secs = 0;
+	
+	size_t size = signgrid_size(sg), stride = signgrid_stride(sg);
+	uint64_t *srow = sg->signs;
+	for(int y = 0; y <= rect.rows; y++, py -= chei, srow += stride){
+		uint64_t *s = srow;
+		for(int k = 0; k < count && rowvals; k++, s += size){
+			if(!(eqs[k]->native_row)) continue;
+			double before = work ? stats_now() : 0;
+			eqs[k]->native_row(xs, py, rowvals, rowlen);
+			for(int x = 0; x < rowlen; x++) signrow_put(s, x, rowvals[x] <= 0);
+			if(work){
+				double secs = stats_now() - before;
+				add_draw_time(eqs[k], secs);
+				native_secs += secs;
+			}
+		}
+		if(interpreted == 0) continue;
+		
+		xref = rect.x;
+		yref = py;
+		rref = hypot(xref, yref);
+		expr_memo_epoch++;
+		for(int i = 0; i < ycount; i++) yhoists[i].value = eval_expr(yhoists[i].hoisted, NULL);
+		
+		for(int x = 0; x < rowlen; x++){
+			// Set up point once for every equation
+			xref = xs[x];
+			yref = py;
+			rref = hypot(xref, yref);
+			expr_memo_epoch++;
+			for(int i = 0; i < xcount; i++) xhoists[i].value = xvals[x * xcount + i];
+			
+			s = srow;
+			for(int k = 0; k < count; k++, s += size){
+				if(eqs[k]->native_row) continue;
+				unsigned long before = work ? stats_evals(&stats) : 0;
+				signrow_put(s, x, eval_expr(eqs[k]->left, NULL) - eval_expr(eqs[k]->right, NULL) <= 0);
+				if(work) work[k] += stats_evals(&stats) - before;
+			}
+		}
+	}
+	
+	if(work){
+		double secs = stats_now() - start - native_secs;
+		unsigned long total = 0;
+		for(int k = 0; k < count; k++) total += work[k];
+		for(int k = 0; k < count; k++){
+			if(!(eqs[k]->native_row)) add_draw_time(eqs[k], total ? secs * work[k] / total : secs / interpreted);
+		}
+		free(work);
+	}
+	
+	expr_unhoist(yhoists, ycount);
+	expr_unhoist(xhoists, xcount);
+	free(xvals);
+	free(rowvals);
+	free(xs);
+	trace_end("sample_equats");
+}
+
+// Bind the builtins of every equation of gallery to the given precision
+static void set_precision(equat_t gallery, expr_precision_t new_precision){
+	precision = new_precision;
+	for(equat_t eq = gallery; eq; eq = eq->next){
+		if(!(eq->is_variable) && eq->left) expr_set_precision(eq->left, precision);
+		if(eq->right) expr_set_precision(eq->right, precision);
+	}
+}
+
+// Draw curves of all proper equations in the gallery
+// Builtins are approximated while drawing since only the signs near the curves matter
+void draw_curves(graph_t gr, equat_t gallery, render_t renderer, signgrid_t *sg){
+	// Collect curves to be sampled together
+	int count = 0;
+	for(equat_t eq = gallery; eq; eq = eq->next){
+		if(!(eq->is_variable) && eq->right) count++;
+	}
+	equat_t *eqs = malloc((count > 0 ? count : 1) * sizeof(equat_t));
+	trace_begin("draw_curves", NULL);
+	set_precision(gallery, EXPR_FAST);
+	
+	count = 0;
+	double start = 0;
+	for(equat_t eq = gallery; eq; eq = eq->next){
+		if(!(eq->is_variable) && eq->right){
+			eq->draw_time = 0;
+			
+			// Braille samples every curve so they all share its resolution
+			if(renderer == RENDER_BRAILLE || (eq->solve == SOLVE_NONE && renderer == RENDER_SCAN)){
+				eqs[count++] = eq;
+			}else{
+				if(stats_enabled) start = stats_now();
+				trace_begin("draw_curve", trace_enabled ? equat_text(eq) : NULL);
+				draw_equat(gr, eq, renderer);
+				trace_end("draw_curve");
+				if(stats_enabled) add_draw_time(eq, stats_now() - start);
+			}
+		}
+	}
+	
+	struct bound_s rect = {.x = gr.x, .y = gr.y, .width = gr.wid, .height = gr.hei, .rows = gr.tg->rows, .columns = gr.tg->cols};
+	if(renderer == RENDER_BRAILLE){
+		// Lattice of the dots in every cell
+		rect.rows *= 4;
+		rect.columns *= 2;
+	}
+	
+	sample_equats(sg, rect, eqs, count);
+	for(int k = 0; k < sg->count; k++){
+		if(stats_enabled) start = stats_now();
+		trace_begin("draw_curve", trace_enabled ? equat_text(eqs[k]) : NULL);
+		if(renderer == RENDER_BRAILLE){
+			draw_braille(gr, signgrid_plane(sg, k), eqs[k]->color_pair);
+		}else{
+			draw_signs(gr, signgrid_plane(sg, k), eqs[k]->color_pair);
+		}
+		trace_end("draw_curve");
+		if(stats_enabled) add_draw_time(eqs[k], stats_now() - start);
+	}
+	
+	set_precision(gallery, EXPR_PRECISE);
+	free(eqs);
+	trace_end("draw_curves");
+}
+
+// Draw curve of equation using the fastest method available
+void draw_equat(graph_t gr, equat_t eq, render_t renderer){
+	if(renderer == RENDER_BRAILLE){
+		// Braille needs the signs of all of the dots
+		signgrid_t sg = {0};
+		struct bound_s rect = {.x = gr.x, .y = gr.y, .width = gr.wid, .height = gr.hei, .rows = 4 * gr.tg->rows, .columns = 2 * gr.tg->cols};
+		sample_equats(&sg, rect, &eq, 1);
+		if(sg.count) draw_braille(gr, signgrid_plane(&sg, 0), eq->color_pair);
+		signgrid_free(&sg);
+	}else if(eq->solve != SOLVE_NONE){
+		// Equations linear in y or x only need to be evaluated once per column or line
+		draw_func(gr, solve_equat, eq, eq->solve == SOLVE_X, eq->color_pair);
+	}else if(renderer == RENDER_TRACE){
+		trace_curve(gr, eval_equat, eq, eq->color_pair);
+	}else{
+		draw_curve(gr, eval_equat, eq, eq->color_pair);
+	}
+}
+
+// Check if both sides of eq are at most linear in var and at least one side depends on it
+static bool is_linear(equat_t eq, expr_t var, expr_t coupled){
+	int ldeg = expr_degree(eq->left, var, coupled), rdeg = expr_degree(eq->right, var, coupled);
+	return ldeg >= 0 && rdeg >= 0 && (ldeg == 1 || rdeg == 1);
+}
+
+// Determine whether equation is linear in y or x so that it can be drawn as a function
+static solve_t find_solve(equat_t eq){
+	expr_t xvar = cached_expr(new_expr(), &xref);
+	expr_t yvar = cached_expr(new_expr(), &yref);
+	// Radius depends non-linearly on both x and y
+	expr_t rvar = cached_expr(new_expr(), &rref);
+	
+	solve_t solve = SOLVE_NONE;
+	if(is_linear(eq, yvar, rvar)) solve = SOLVE_Y;
+	else if(is_linear(eq, xvar, rvar)) solve = SOLVE_X;
+	
+	free_expr(xvar);
+	free_expr(yvar);
+	free_expr(rvar);
+	return solve;
+}
+
 
 
 // Display linked list of equation to given window
-void draw_gallery(WINDOW *win, equat_t top, bool show_curs){
-	int wid, hei;
-	getmaxyx(win, hei, wid);
+void draw_gallery(target_t *tg, equat_t top, bool show_curs){
+	int wid = tg->cols, hei = tg->rows;
 	
 	// Draw box around gallery
-	wborder(win, '*', '*', '*', '*', '*', '*', '*', '*');
+	for(int x = 0; x < wid; x++){
+		tg->put(tg, x, 0, '*', 0);
+		tg->put(tg, x, hei - 1, '*', 0);
+	}
+	for(int y = 1; y < hei - 1; y++){
+		tg->put(tg, 0, y, '*', 0);
+		tg->put(tg, wid - 1, y, '*', 0);
+	}
 	
 	int x, y, i = 0;
 	// i represents the index of the textbox
-	char *s;
 	// Iterate over equations and display each
 	for(equat_t eq = top; eq; eq = eq->next){
 		x = 1;
 		y = i * (TEXTBOX_HEIGHT + 1) + 1;
 		// Iterate over characters in text of equation `eq`
-		for(s = eq->text; *s != '\0' || (eq->curs == s && show_curs); s++){
+		size_t len = equat_len(eq);
+		for(size_t k = 0; k < len || (eq->curs == (long)k && show_curs); k++){
 			// Check to see if character is out of bounds
 			if(y >= hei - 1 || y >= i * (TEXTBOX_HEIGHT + 1) + TEXTBOX_HEIGHT - 1) break;
 			
-			if(s == eq->curs && show_curs){
-				wattron(win, COLOR_PAIR(INVERT_PAIR));
-				// Display '\0' as ' ' when highlighted
-				mvwaddch(win, y, x, *s == '\0' ? ' ' : *s);
-				wattroff(win, COLOR_PAIR(INVERT_PAIR));
+			// Skip over the gap
+			char ch = k == len ? ' ' : eq->text[k < eq->gap ? k : k + eq->gap_end - eq->gap];
+			if(eq->curs == (long)k && show_curs){
+				// Display end of text as ' ' when highlighted
+				tg->put(tg, x, y, ch, INVERT_PAIR);
 			}else{
-				mvwaddch(win, y, x, *s);
+				tg->put(tg, x, y, ch, 0);
 			}
 			x++;
 			// Move print location back to beginning of next line to wrap text
@@ -108,32 +426,25 @@ void draw_gallery(WINDOW *win, equat_t top, bool show_curs){
 					// Draw color picker bar at bottom
 					
 					// Use inverted color pair to indicate selection
-					wattron(win, COLOR_PAIR(eq->color_pair | ((eq->curs == eq->text - 1) && show_curs ? INVERT_PAIR : 0) ));
+					int color = eq->color_pair | (eq->curs == CURS_PICKER && show_curs ? INVERT_PAIR : 0);
 					for(x = 1; x < wid - 1; x++){
-						mvwaddch(win, y, x, '-');
+						tg->put(tg, x, y, '-', color);
 					}
-					wattroff(win, COLOR_PAIR(eq->color_pair | ((eq->curs == eq->text - 1) && show_curs ? INVERT_PAIR : 0)));
 				}
 			}else{
 				// Display parse error instead of color picker if there was one
 				char buf[wid]; // Create buffer to store and potentially truncate error message
 				buf[0] = '\0';
-				strncat(buf, parse_errstr[eq->err], wid - 1);
-				if(i == 0 && !(eq->curs) && show_curs){
-					// Highlight error if cursor on it to indicate the cursor's location
-					wattron(win, COLOR_PAIR(INVERT_PAIR));
-					mvwprintw(win, y, 1, "%s", buf);
-					wattroff(win, COLOR_PAIR(INVERT_PAIR));
-				}else{
-					mvwprintw(win, y, 1, "%s", buf);
-				}
+				strncat(buf, parse_errstr[eq->err], wid - 2);
+				// Highlight error if cursor on it to indicate the cursor's location
+				tg->print(tg, 1, y, buf, i == 0 && eq->curs == CURS_HIDDEN && show_curs ? INVERT_PAIR : 0);
 			}
 		}
 		y++;
 		
 		// Draw divider between textboxes
 		for(x = 1; x < wid - 1; x++){
-			mvwaddch(win, y, x, '*');
+			tg->put(tg, x, y, '*', 0);
 		}
 		
 		i++; // Move textbox index ahead
@@ -212,109 +523,200 @@ static parse_err_t parse_var_equat(equat_t eq){
 	return ERR_OK;
 }
 
-parse_err_t parse_equat(equat_t gallery, equat_t eq){
-	if(eq->being_parsed) return ERR_BAD_EXPRESSION; // If equation already being parsed return
-	eq->being_parsed = 1;
-	
-	// Split arg on '=' to create the left and right strings
-	char *right;
-	for(right = eq->text; *right && *right != '='; right++){}
-	// If no '=' exists return err
-	if(!(*right)){
-		eq->err = ERR_BAD_EXPRESSION;
-		eq->being_parsed = 0;
-		return eq->err;
+// Deallocate the list of arguments of the variable being parsed
+static void free_arguments(void){
+	struct arg_s *arg = arguments, *tmp;
+	while(arg){
+		tmp = arg->next;
+		free(arg);
+		arg = tmp;
 	}
+	arguments = NULL;
+}
+
+// Names of variables left in a cycle can't be resolved
+// so eq is given the error of the cycle instead since it depends on it
+static parse_err_t blame_cycle(equat_t eq){
+	if(eq->err != ERR_UNRECOGNIZED_NAME) return eq->err;
+	for(int i = 0; i < eq->deps.count; i++){
+		if(eq->deps.items[i]->err == ERR_CIRCULAR) eq->err = ERR_CIRCULAR;
+	}
+	return eq->err;
+}
+
+void drop_native(equat_t eq){
+	if(eq->native_handle && eq->native_close) eq->native_close(eq->native_handle);
+	eq->native = NULL;
+	eq->native_row = NULL;
+	eq->native_handle = NULL;
+	eq->native_close = NULL;
+}
+
+// Parse the name and arguments of the variable eq whose text has its '=' at right
+// The arguments are left in arguments if they parse
+static parse_err_t parse_var_name(equat_t eq, char *right){
+	eq->name = NULL;
+	eq->name_len = 0;
 	
+	*(right - 1) = '\0';
+	eq->err = parse_var_equat(eq);
+	*(right - 1) = ':';
+	
+	if(eq->err != ERR_OK){
+		// Deallocate the arguments on error
+		free_arguments();
+		
+		eq->name = NULL;  // Name is not usable by other equations
+	}
+	return eq->err;
+}
+
+// Free what was made from the old text of eq and remove it from the dependency graph and the table of variables
+// The old right hand side is returned since other equations may still reference it until they are reparsed
+static expr_t release_equat(equat_t eq){
+	// Native code and the packed copy were made from the old expressions
+	drop_native(eq);
+	eq->compile_failed = 0;
+	free_pack(eq->packed);
+	eq->packed = NULL;
+	
+	expr_t old_right = eq->right;
+	eq->right = NULL;
+	if(eq->is_variable) eq->memo.ref = NULL;
 	
 	// If left hand expression already exists free it
-	if(!(eq->is_variable) && eq->left) free_expr(eq->left);
+	if(!(eq->is_variable) && eq->left){
+		free_expr(eq->left);
+		eq->left = NULL;
+	}
+	
+	clear_deps(eq);
+	// Name may change so it is added back once the left hand side is parsed
+	if(eq->is_variable && eq->sym){
+		symtab_remove(&variables, eq->sym);
+		eq->sym = NULL;
+	}
+	return old_right;
+}
+
+// Release eq and enter the name its text now defines into the table of variables
+// Returns the old right hand side like release_equat
+// Only the left hand side of a variable is parsed so eq still has to be parsed by parse_single
+static expr_t declare_equat(equat_t eq){
+	expr_t old_right = release_equat(eq);
+	
+	// If no '=' exists the equation can't be parsed
+	char *right = strchr(equat_text(eq), '=');
+	if(!right){
+		eq->err = ERR_BAD_EXPRESSION;
+		return old_right;
+	}
 	
 	// If equation is separated by ':=' instead of '=' then treat equation as variable
-	if(*(right - 1) == ':'){
+	if(right > eq->text && *(right - 1) == ':'){
 		eq->is_variable = 1; // Designate equation as representing a variable
+		eq->sym = NULL;
 		
-		// Initialize name to NULL
-		eq->name = NULL;
-		eq->name_len = 0;
-		
-		// Parse variable name and possibly arguments on left hand side
-		*(right - 1) = '\0';
-		eq->err = parse_var_equat(eq);
-		*(right - 1) = ':';
-		
-		if(eq->err != ERR_OK){
-			// Deallocate the arguments on error
-			struct arg_s *arg = arguments, *tmp;
-			while(arg){
-				tmp = arg->next;
-				free(arg);
-				arg = tmp;
-			}
-			arguments = NULL;
-			
-			eq->being_parsed = 0;
-			return eq->err;
+		// Make name available to other equations (and this one to detect self reference)
+		if(parse_var_name(eq, right) == ERR_OK){
+			free_arguments();
+			eq->sym = symtab_add(&variables, eq->name, eq->name_len, eq);
 		}
 	}else{
 		eq->is_variable = 0; // Designate equation as proper equation
+		eq->left = NULL;
+		eq->solve = SOLVE_NONE;  // Only determined once both sides are parsed
 		eq->err = ERR_OK;
+		// Times of the old curve don't apply to the new one
+		eq->draw_time = 0;
+		eq->draw_total = 0;
+	}
+	return old_right;
+}
+
+// Check if the name of length n is one of the arguments listed on the left of a variable
+// left holds the text before its ":=" starting with the name of the variable
+static bool is_argument(const char *left, const char *end, const char *name, size_t n){
+	bool first = 1;
+	for(const char *s = left; s < end;){
+		if(!isalpha(*s)){
+			s++;
+			continue;
+		}
 		
+		const char *arg = s;
+		while(s < end && isalnum(*s)) s++;
+		if(!first && (size_t)(s - arg) == n && strncmp(arg, name, n) == 0) return 1;
+		first = 0;
+	}
+	return 0;
+}
+
+// Record every variable named in the expressions of eq as a dependency without parsing them
+// Names are split the way the parser splits them and skipped when the parser resolves them before the variables
+// The edges are a superset of the ones parsing records so eq can be parsed once after all of them
+static void scan_deps(equat_t eq){
+	clear_deps(eq);
+	char *right = strchr(equat_text(eq), '=');
+	if(!right || (eq->is_variable && !(eq->sym))) return;
+	
+	// Only the right hand side of a variable is an expression
+	const char *s = eq->is_variable ? right + 1 : eq->text;
+	while(*s){
+		if(isalpha(*s)){
+			const char *name = s;
+			while(isalnum(*s)) s++;
+			size_t n = (size_t)(s - name);
+			
+			if(expr_find_builtin(name, n)) continue;
+			if(eq->is_variable && is_argument(eq->text, right - 1, name, n)) continue;
+			if(n == 1 && (*name == 'x' || *name == 'y' || *name == 'r')) continue;
+			for(struct sym_s *sym = symtab_find(&variables, name, n); sym; sym = symtab_next(sym)) add_dep(eq, sym->value);
+		}else if(isdigit(*s) || *s == '.'){
+			// Numbers are skipped whole so the letters of exponents and hexadecimal digits aren't taken for names
+			char *end;
+			strtod(s, &end);
+			s = end > s ? end : s + 1;
+		}else{
+			s++;
+		}
+	}
+}
+
+// Parse the expressions of eq once declare_equat has declared it
+// The references found while parsing become the dependencies of eq
+static parse_err_t parse_single(equat_t gallery, equat_t eq){
+	// Name of the variable or the '=' failed to parse
+	if(eq->err != ERR_OK) return eq->err;
+	
+	clear_deps(eq);
+	char *right = strchr(eq->text, '=');
+	if(eq->is_variable){
+		// Parse the arguments again since they are only held while parsing one equation
+		parse_var_name(eq, right);
+	}else{
 		// Ensure no arguments are parsed on left hand side
 		arguments = NULL;
 		
 		// Parse left hand side
+		parsing = eq;
 		*right = '\0';  // Put null where '=' is to restrict parsing to left side
 		eq->left = parse_expr(eq->text, translate_name, NULL, &(eq->err), gallery);
 		*right = '=';  // Undo replacement
-		if(eq->err != ERR_OK){
-			eq->being_parsed = 0;
-			return eq->err;
-		}
+		parsing = NULL;
+		if(eq->err != ERR_OK) return blame_cycle(eq);
 	}
 	
 	// Move right to after the '='
 	right++;
 	
-	expr_t old_ref = eq->right; // Save right hand side to later check for dependencies and update them
-	
 	// Parse right hand side
+	parsing = eq;
 	eq->right = parse_expr(right, translate_name, NULL, &(eq->err), gallery);
+	parsing = NULL;
 	
 	// Deallocate the arguments
-	struct arg_s *arg = arguments, *tmp;
-	while(arg){
-		tmp = arg->next;
-		free(arg);
-		arg = tmp;
-	}
-	arguments = NULL;
-	
-	if(old_ref){
-		// Construct target to check for dependency
-		expr_t target = new_expr();
-		apply_expr(target, old_ref, 0, NULL);
-		
-		// Reparse equations dependent on this one
-		for(equat_t eq2 = gallery; eq2; eq2 = eq2->next){
-			if(eq2 == eq) continue; // Skip self
-			
-			if(!(eq2->is_variable) && eq2->left){
-				// If equation has left hand side check left for dependency
-				if(expr_depends(eq2->left, target)){
-					parse_equat(gallery, eq2);
-				}
-			}
-			
-			// If equation has right hand side check right for dependency
-			if(eq2->right && expr_depends(eq2->right, target)){
-				parse_equat(gallery, eq2);
-			}
-		}
-		
-		free_expr(target); // Deallocate dependency checking target
-		free_expr(old_ref); // Finally free right hand side
-	}
+	free_arguments();
 	
 	if(eq->err != ERR_OK){
 		// Left expression successfully parsed and so must be properly deallocated
@@ -323,44 +725,292 @@ parse_err_t parse_equat(equat_t gallery, equat_t eq){
 			eq->left = NULL;
 		}
 		
-		eq->being_parsed = 0;
-		return eq->err;
+		return blame_cycle(eq);
+	}
+	
+	// Rewrite both sides to take fewer operations to evaluate
+	// The roots are kept in place since variables reference them
+	if(!eq->is_variable) simplify_expr(eq->left);
+	simplify_expr(eq->right);
+	
+	// Point memoized value at the new expression
+	if(eq->is_variable){
+		eq->memo.ref = eq->right;
+		eq->memo.stamp = 0;
 	}
 	
-	eq->being_parsed = 0;
+	// Check if curve can be drawn as a function
+	if(!(eq->is_variable)) eq->solve = find_solve(eq);
+	// Points are evaluated from the packed copy if it can be made
+	if(!(eq->is_variable)) eq->packed = expr_pack(eq->left, eq->right);
+	
 	return ERR_OK;
 }
 
+// Count the dependencies of eq which are still waiting to be reparsed
+static int count_pending(equat_t eq){
+	int pending = 0;
+	for(int k = 0; k < eq->deps.count; k++) pending += eq->deps.items[k]->dirty;
+	return pending;
+}
+
+// Reparse the equations of gallery marked dirty and every equation depending on them in topological order
+// All of them are declared and have their dependencies found from their text first so each is parsed exactly once
+// old_right is freed along with their old right hand sides once no expression references it (NULL if there is none)
+// Equations left over once no equation can be reparsed are in or depend on a cycle
+static void reparse_dirty(equat_t gallery, expr_t old_right){
+	int size = 1;
+	for(equat_t eq = gallery; eq; eq = eq->next) size++;
+	equat_t *dirty = malloc(size * sizeof(equat_t));
+	equat_t *queue = malloc(size * sizeof(equat_t));
+	expr_t *olds = malloc(size * sizeof(expr_t));
+	if(!dirty || !queue || !olds){
+		free(dirty);
+		free(queue);
+		free(olds);
+		if(old_right) free_expr(old_right);
+		return;
+	}
+	
+	// Declare the marked equations first so references to the names they define are found
+	int count = 0, nolds = 0;
+	olds[nolds++] = old_right;
+	for(equat_t eq = gallery; eq; eq = eq->next){
+		if(eq->dirty){
+			dirty[count++] = eq;
+			olds[nolds++] = declare_equat(eq);
+		}
+	}
+	// Names which couldn't be resolved before may be defined now
+	// so the edges of those equations are found again for them to be reached below
+	for(equat_t eq = gallery; eq; eq = eq->next){
+		if(!(eq->dirty) && eq->err == ERR_UNRECOGNIZED_NAME) scan_deps(eq);
+	}
+	
+	// Find the dependencies of each marked equation and mark every equation that depends on it
+	// Those are declared in turn since declaring an equation removes its edges from the lists of users
+	int declared = count;
+	for(int i = 0; i < count; i++){
+		if(i >= declared) olds[nolds++] = declare_equat(dirty[i]);
+		scan_deps(dirty[i]);
+		for(int k = 0; k < dirty[i]->users.count; k++){
+			equat_t user = dirty[i]->users.items[k];
+			if(!(user->dirty)){
+				user->dirty = 1;
+				dirty[count++] = user;
+			}
+		}
+	}
+	
+	// Count the dirty dependencies of each equation
+	// Those without any are ready to be reparsed
+	int head = 0, tail = 0;
+	for(int i = 0; i < count; i++){
+		dirty[i]->pending = count_pending(dirty[i]);
+		if(dirty[i]->pending == 0) queue[tail++] = dirty[i];
+	}
+	
+	// Reparse equations once all of their dirty dependencies are reparsed (Kahn's algorithm)
+	while(head < tail){
+		equat_t eq = queue[head++];
+		parse_single(gallery, eq);
+		eq->dirty = 0;
+		
+		// Release the equations waiting on eq
+		for(int k = 0; k < eq->users.count; k++){
+			equat_t user = eq->users.items[k];
+			if(user->dirty && --(user->pending) == 0) queue[tail++] = user;
+		}
+	}
+	
+	// Remaining equations can never be ready since they are part of or depend on a cycle
+	// Their dependencies are kept so they are reparsed when the cycle is broken
+	for(int i = 0; i < count; i++){
+		equat_t eq = dirty[i];
+		if(!(eq->dirty)) continue;
+		eq->dirty = 0;
+		eq->err = ERR_CIRCULAR;
+	}
+	
+	// No expression references the old right hand sides anymore
+	for(int i = 0; i < nolds; i++) if(olds[i]) free_expr(olds[i]);
+	
+	free(dirty);
+	free(queue);
+	free(olds);
+}
+
+parse_err_t parse_equat(equat_t gallery, equat_t eq){
+	trace_begin("parse_equat", trace_enabled ? equat_text(eq) : NULL);
+	eq->dirty = 1;
+	reparse_dirty(gallery, NULL);
+	
+	trace_end("parse_equat");
+	return eq->err;
+}
+
+void parse_equats(equat_t gallery, equat_t first){
+	trace_begin("parse_equats", NULL);
+	
+	// Parse the new equations together with the ones depending on them in topological order
+	// so variables may be referenced before they are defined
+	for(equat_t eq = first; eq; eq = eq->next) eq->dirty = 1;
+	reparse_dirty(gallery, NULL);
+	trace_end("parse_equats");
+}
+
 // Create and Add equation to gallery and Return it
 equat_t add_equat(equat_t *gallery, const char *text){
 	// Seek to end of gallery to append equation
-	equat_t prev = NULL, *new;
-	for(new = gallery; *new; new = &((*new)->next)){
-		prev = *new;
+	equat_t tail = NULL;
+	for(equat_t eq = *gallery; eq; eq = eq->next) tail = eq;
+	
+	return append_equat(gallery, tail, text);
+}
+
+equat_t append_equat(equat_t *gallery, equat_t tail, const char *text){
+	equat_t new = malloc(sizeof(struct equat_s));
+	if(!new) return NULL;
+	
+	// Place text into the textbox of the equation with the gap after it
+	size_t len = strlen(text);
+	new->text_size = len < TEXTBOX_SIZE ? TEXTBOX_SIZE : len + 1;
+	new->text = calloc(new->text_size, sizeof(char));  // Clear out the rest of the textbox
+	if(!(new->text)){
+		free(new);
+		return NULL;
 	}
-	*new = malloc(sizeof(struct equat_s));
-	// Place text into the textbox of the equation
-	memset((*new)->text, '\0', TEXTBOX_SIZE * sizeof(char));  // Clear out any stale data
-	strncat((*new)->text, text, TEXTBOX_SIZE - 1);
+	memcpy(new->text, text, len);
+	new->gap = len;
+	new->gap_end = new->text_size - 1;
 	
 	// Clear all union values
-	(*new)->name = NULL;
-	(*new)->name_len = 0;
-	(*new)->left = NULL;
-	(*new)->color_pair = 1;
+	new->name = NULL;
+	new->name_len = 0;
+	new->sym = NULL;
+	new->left = NULL;
+	new->color_pair = 1;
+	new->solve = SOLVE_NONE;
 	
-	(*new)->is_variable = 0; // Default to proper equation
-	(*new)->curs = (*new)->text;
-	(*new)->err = ERR_OK;
+	new->is_variable = 0; // Default to proper equation
+	new->curs = 0;
+	new->err = ERR_OK;
+	new->draw_time = 0;
+	new->draw_total = 0;
+	new->compile_failed = 0;
+	new->native = NULL;
+	new->native_row = NULL;
+	new->native_handle = NULL;
+	new->native_close = NULL;
+	new->packed = NULL;
 	
 	// Ensure that left and right are null to prevent parse_equat from accidentally freeing unallocated space
-	(*new)->right = NULL;
+	new->right = NULL;
+	
+	// Equation isn't part of the dependency graph until it is parsed
+	new->dirty = 0;
+	new->deps = (struct equat_list_s){NULL, 0, 0};
+	new->users = (struct equat_list_s){NULL, 0, 0};
+	new->pending = 0;
+	
+	// Link equation after tail
+	new->prev = tail;
+	new->next = NULL;
+	if(tail) tail->next = new;
+	else *gallery = new;
+	
+	return new;
+}
+
+void remove_equat(equat_t *gallery, equat_t eq){
+	// Unlink equation so it can't be referenced anymore
+	if(eq->prev) eq->prev->next = eq->next;
+	else if(*gallery == eq) *gallery = eq->next;
+	if(eq->next) eq->next->prev = eq->prev;
+	eq->prev = NULL;
+	eq->next = NULL;
 	
-	// Set default parameters
-	(*new)->prev = prev;
-	(*new)->next = NULL;
+	// Reparse the equations that referenced it
+	for(int i = 0; i < eq->users.count; i++) eq->users.items[i]->dirty = 1;
+	reparse_dirty(*gallery, release_equat(eq));
 	
-	return *new;
+	// Reparsing finds the edges of the users again without eq unless it couldn't allocate
+	for(int i = 0; i < eq->users.count; i++) list_remove(&(eq->users.items[i]->deps), eq);
+	
+	free(eq->deps.items);
+	free(eq->users.items);
+	free(eq->text);
+	free(eq);
 }
 
+size_t equat_len(equat_t eq){
+	return eq->gap + (eq->text_size - 1 - eq->gap_end);
+}
+
+// Move the gap of the text of eq so it starts pos characters into the text
+static void move_gap(equat_t eq, size_t pos){
+	if(pos < eq->gap){
+		// Move the characters between pos and the gap after it
+		size_t n = eq->gap - pos;
+		memmove(eq->text + eq->gap_end - n, eq->text + pos, n);
+		eq->gap -= n;
+		eq->gap_end -= n;
+	}else if(pos > eq->gap){
+		// Move the characters between the gap and pos before it
+		size_t n = pos - eq->gap;
+		memmove(eq->text + eq->gap, eq->text + eq->gap_end, n);
+		eq->gap += n;
+		eq->gap_end += n;
+	}
+}
 
+char *equat_text(equat_t eq){
+	move_gap(eq, equat_len(eq));
+	eq->text[eq->gap] = '\0';
+	return eq->text;
+}
+
+bool set_equat_text(equat_t eq, const char *text){
+	size_t len = strlen(text);
+	if(len + 1 > eq->text_size){
+		char *buf = realloc(eq->text, len + 1);
+		if(!buf) return 0;
+		eq->text = buf;
+		eq->text_size = len + 1;
+	}
+	
+	// Text followed by the gap
+	memcpy(eq->text, text, len);
+	eq->gap = len;
+	eq->gap_end = eq->text_size - 1;
+	eq->text[eq->gap_end] = '\0';
+	if(eq->curs > (long)len) eq->curs = len;
+	return 1;
+}
+
+bool insert_equat_char(equat_t eq, char c){
+	if(eq->gap == eq->gap_end){
+		// Double the buffer and move the characters after the gap to the end
+		size_t size = 2 * eq->text_size, after = eq->text_size - eq->gap_end;
+		char *text = realloc(eq->text, size);
+		if(!text) return 0;
+		memmove(text + size - after, text + eq->gap_end, after);
+		
+		eq->text = text;
+		eq->gap_end = size - after;
+		eq->text_size = size;
+	}
+	
+	move_gap(eq, eq->curs);
+	eq->text[eq->gap++] = c;
+	eq->curs++;
+	return 1;
+}
+
+void erase_equat_char(equat_t eq){
+	if(eq->curs <= 0) return;
+	
+	move_gap(eq, eq->curs);
+	eq->gap--;
+	eq->curs--;
+}
@@ -1,16 +1,36 @@
 #ifndef _GALLERY_H
 #define _GALLERY_H
 
-#include "ncurses.h"
 #include "expr.h"
+#include "graph.h"
+#include "signgrid.h"
+#include "symtab.h"
 
 // Mask used that should be used on color pairs to created inverted versions
 #define INVERT_PAIR 0x80
 
 #define GALLERY_WIDTH 25 // Size of gallery in ncurses
-#define TEXTBOX_SIZE 64
+#define TEXTBOX_SIZE 64  // Minimum size of the text buffer of a textbox
 #define TEXTBOX_HEIGHT 4  // Height of each textbox
 
+// Values of the cursor of an equation when it isn't in the text
+#define CURS_PICKER -1  // Focus on color picker
+#define CURS_HIDDEN -2  // Don't display cursor
+
+// Unknown that a proper equation can be explicitly solved for
+// Equations linear in y (or x) are drawn as functions instead of implicit curves
+typedef enum{
+	SOLVE_NONE = 0,  // Only drawable as implicit curve
+	SOLVE_Y,  // Linear in y so y = f(x)
+	SOLVE_X   // Linear in x so x = f(y)
+} solve_t;
+
+// Growable list of equations used for the edges of the dependency graph
+struct equat_list_s{
+	struct equat_s **items;
+	int count, cap;
+};
+
 /* Represent equation attached to a textbox
  * Forms:
  *   Proper Equation / Non-Variable : Used for curves that will be drawn to graph
@@ -19,14 +39,20 @@
  *     Ex: "w := x^2 - y" or "f(a, b, x, y) := a*b + x*y"
  */
 typedef struct equat_s{
-	// Contents of textbox
-	char text[TEXTBOX_SIZE];
+	/* Contents of textbox kept as a gap buffer of text_size bytes
+	 * The characters are text[0, gap) followed by text[gap_end, text_size - 1)
+	 * Edits move the gap to the cursor so typing and deleting there take constant time
+	 * Use equat_text to close the gap when the text must be read as a string
+	 */
+	char *text;
+	size_t text_size, gap, gap_end;
 	
-	// Indicates if current equation is being parsed
-	// Used to prevent circular recursion when reparsing dependencies
-	bool being_parsed : 1;
+	// Indicates if equation must be reparsed because an equation it depends on changed
+	bool dirty : 1;
 	// Indicates if this equation represents a variable
 	bool is_variable : 1;
+	// Indicates if compile_equat failed for the current text so compile_equats doesn't retry it until it is reparsed
+	bool compile_failed : 1;
 	
 	union{
 		// VARIABLE
@@ -38,6 +64,13 @@ typedef struct equat_s{
 			
 			// Number of arguments to variable if equation represents variable
 			int arity;
+			
+			// Entry of the variable in the table of variable names (NULL if it has no name)
+			struct sym_s *sym;
+			
+			// Value of variable shared by every expression that references it
+			// Only used when the variable has no arguments
+			expr_memo_t memo;
 		};
 		
 		// NON-VARIABLE / PROPER EQUATION
@@ -49,32 +82,103 @@ typedef struct equat_s{
 			// Variable equations are not drawn and so don't need a color
 			// Color for curve of equation
 			int color_pair;
+			// Whether equation can be drawn as function of x or y
+			solve_t solve;
 		};
 	};
 	
-	// Indicate location of cursor in text
-	// If curs == text - 1 then focus on color picker
-	// If curs == NULL then don't display cursor
-	char *curs;
+	// Index of the cursor in the text
+	// Or CURS_PICKER or CURS_HIDDEN if it isn't in the text
+	long curs;
 	// Store error code for any parse errors that occur
 	parse_err_t err;
 	
+	// Seconds spent sampling and drawing the curve in the last redraw and in all of them
+	// Only measured while stats_enabled is set (see stats.h)
+	double draw_time, draw_total;
+	
+	// Native code compiled from a proper equation by compile_equat (see compile.h), NULL while it is interpreted
+	// native evaluates the equation at a point and native_row evaluates it at each of the n points (xs[i], y) into out
+	// Both are dropped whenever the equation is reparsed or removed
+	double (*native)(double x, double y);
+	void (*native_row)(const double *xs, double y, double *out, int n);
+	// Handle of the object holding the native code and the function that closes it when the code is dropped
+	// The gallery doesn't link to the dynamic loader itself so compile_equat supplies the function
+	void *native_handle;
+	int (*native_close)(void *handle);
+	// Copy of left - right packed by expr_pack (see expr.h) that eval_equat evaluates, NULL if it could not be packed
+	// Sampling for drawing still uses the expressions since it rearranges them
+	expr_pack_t packed;
+	
 	// Right hand side of equation
 	expr_t right;
 	
+	// Edges of the dependency graph between the equations of the gallery
+	// deps holds the variables this equation references (by name, even if they failed to parse)
+	// users holds the equations which reference this one
+	struct equat_list_s deps, users;
+	// Number of dirty equations in deps which haven't been reparsed yet
+	int pending;
+	
 	// Point to previous and next equation in the linked list
 	struct equat_s *prev, *next;
 } *equat_t;
 
+// Location the value of the graph parameter name ('x', 'y', or 'r') is read from by expressions
+// Returns NULL for any other name
+double *equat_param(char name);
 // Evaluate equation by subtracting the right side from the left
 double eval_equat(void *inp, double x, double y);
+// Evaluate the unknown of an equation with solve != SOLVE_NONE
+// Given t = x returns y if solve == SOLVE_Y and given t = y returns x if solve == SOLVE_X
+double solve_equat(void *inp, double t);
+
+// Sample the signs of count proper equations in one pass over the lattice of rect
+// Each point's x, y, r, and memoized variables are calculated once and shared by every equation
+// The planes of sg are identified by the equations
+void sample_equats(signgrid_t *sg, struct bound_s rect, equat_t *eqs, int count);
+// Draw the curves of every proper equation in gallery onto gr in their colors
+// Curves that are sampled (implicit curves with RENDER_SCAN and every curve with RENDER_BRAILLE)
+// are sampled together and their signs are left in sg marked approximate
+void draw_curves(graph_t gr, equat_t gallery, render_t renderer, signgrid_t *sg);
 
-// Display linked list of equation to given window
-void draw_gallery(WINDOW *win, equat_t top, bool show_curs);
+// Draw the curve of a proper equation onto gr in its color
+// Equations that can't be solved for y or x are drawn using renderer
+void draw_equat(graph_t gr, equat_t eq, render_t renderer);
+
+// Display linked list of equations starting from top onto the target
+void draw_gallery(target_t *tg, equat_t top, bool show_curs);
 // Use text of equation to generate the left and right hand expressions
+// Every equation depending on eq is then reparsed once in topological order
+// Equations which end up depending on themselves are given the error ERR_CIRCULAR
 parse_err_t parse_equat(equat_t gallery, equat_t eq);
+// Parse every equation from first to the end of gallery
+// The dependencies between them are found from their text before any is parsed
+// so variables may be referenced before they are defined and each equation is parsed once
+void parse_equats(equat_t gallery, equat_t first);
 // Create new equation at the end of gallery
 // With the given null terminated text in the textbox
 equat_t add_equat(equat_t *gallery, const char *text);
+// Create new equation after tail without seeking to the end of gallery
+// tail must be the last equation of gallery or NULL if gallery is empty
+// Returns NULL if memory could not be allocated
+equat_t append_equat(equat_t *gallery, equat_t tail, const char *text);
+// Unlink eq from gallery, reparse the equations depending on it, and deallocate it
+void remove_equat(equat_t *gallery, equat_t eq);
+// Close the native code of eq (see compile.h) so it is interpreted again
+void drop_native(equat_t eq);
+
+// Number of characters in the text of eq
+size_t equat_len(equat_t eq);
+// Move the gap of the text of eq to its end and return the text as a null terminated string
+char *equat_text(equat_t eq);
+// Replace the text of eq with the null terminated text without parsing it
+// Returns false if memory could not be allocated
+bool set_equat_text(equat_t eq, const char *text);
+// Insert c into the text of eq before its cursor and move the cursor after it
+// Returns false if memory could not be allocated
+bool insert_equat_char(equat_t eq, char c);
+// Remove the character before the cursor of eq
+void erase_equat_char(equat_t eq);
 
 #endif
@@ -1,11 +1,17 @@
+#include <stdio.h>
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include "graph.h"
+#include "signgrid.h"
+
+
+// Place character ch with color pair color in cell (x, y) of the graph's target
+#define put_cell(gr, x, y, ch, color) ((gr).tg->put((gr).tg, (x), (y), (ch), (color)))
 
 
 bool to_graph(graph_t gr, int tx, int ty, double *px, double *py){
-	int tw, th; // Store window width and height
-	getmaxyx(gr.win, th, tw);
+	int tw = gr.tg->cols, th = gr.tg->rows; // Store target width and height
 	if(px) *px = gr.x + tx * gr.wid / tw;
 	if(py) *py = gr.y - ty * gr.hei / th;
 	
@@ -13,8 +19,7 @@ bool to_graph(graph_t gr, int tx, int ty, double *px, double *py){
 }
 
 bool from_graph(graph_t gr, double px, double py, int *tx, int *ty){
-	int tw, th; // Store window width and height
-	getmaxyx(gr.win, th, tw);
+	int tw = gr.tg->cols, th = gr.tg->rows; // Store target width and height
 	if(tx) *tx = (int) ((px - gr.x) * tw / gr.wid);
 	if(ty) *ty = (int) ((gr.y - py) * th / gr.hei);
 	
@@ -47,30 +52,38 @@ void setdims_graph(graph_t *gr, double w, double h){
 
 
 
-void draw_gridlines(graph_t gr){
+void grid_spacing(graph_t gr, double *cw, double *ch){
 	// Width and height between gridlines
 	double lgw, lgh;
 	lgw = log10(gr.wid / 2.5);
 	lgh = log10(gr.hei / 2.5);
 	
-	double cw, ch;
 	// Use greatest power of ten less than the width and height
-	cw = pow(10, floor(lgw));
-	ch = pow(10, floor(lgh));
+	*cw = pow(10, floor(lgw));
+	*ch = pow(10, floor(lgh));
 	// Check if demarcations of 2 * 10^p would work
 	// log10(2) = 0.69897000433
-	cw *= lgw - floor(lgw) > 0.69897000433 ? 5 : 1;
-	ch *= lgh - floor(lgh) > 0.69897000433 ? 5 : 1;
-	
-	
+	*cw *= lgw - floor(lgw) > 0.69897000433 ? 5 : 1;
+	*ch *= lgh - floor(lgh) > 0.69897000433 ? 5 : 1;
+}
+
+void draw_gridlines(graph_t gr){
+	double cw, ch;
+	grid_spacing(gr, &cw, &ch);
+	draw_gridlines_at(gr, cw, ch);
+}
+
+void draw_gridlines_at(graph_t gr, double cw, double ch){
 	// Pre-calculate the initial values of x0 and y0 for multiple uses
 	double x0_init, y0_init;
 	x0_init = cw * floor((gr.x + gr.wid) / cw);
 	y0_init = ch * (1 + floor((gr.y - gr.hei) / ch));
 	
-	// Store the width and height of the terminal window
-	int tw, th;
-	getmaxyx(gr.win, th, tw);
+	// Store the width and height of the target
+	int tw = gr.tg->cols, th = gr.tg->rows;
+	// Labels are only drawn if the target can display text
+	bool labels = gr.tg->print != NULL;
+	char buf[32];
 	
 	// Calculate location of origin on screen
 	int zeroX, zeroY;
@@ -83,32 +96,38 @@ void draw_gridlines(graph_t gr){
 		
 		// Draw vertical line
 		for(y = 0; y < th; y++){
-			mvwaddch(gr.win, y, x, x == zeroX ? '$' : '|');
+			put_cell(gr, x, y, x == zeroX ? '$' : '|', 0);
 		}
 		
 		// Draw labels
-		mvwprintw(gr.win, 0, x, "%.10lg", x0);
+		if(labels){
+			snprintf(buf, sizeof(buf), "%.10lg", x0);
+			gr.tg->print(gr.tg, x, 0, buf, 0);
+		}
 	}
 	
 	for(y0 = y0_init; y0 <= gr.y; y0 += ch){
 		from_graph(gr, 0, y0, NULL, &y);
 		
 		// Prevent second loop from overwriting labels made by first
-		if(y == 0) continue;
+		if(labels && y == 0) continue;
 		
 		// Draw horizontal line
 		for(x = 0; x < tw; x++){
-			mvwaddch(gr.win, y, x, y == zeroY ? '=' : '-');
+			put_cell(gr, x, y, y == zeroY ? '=' : '-', 0);
 		}
 		
 		// Redraw intersections as '+'
 		for(x0 = x0_init; x0 > gr.x; x0 -= cw){
 			from_graph(gr, x0, 0, &x, NULL);
-			mvwaddch(gr.win, y, x, y == zeroY ? '#' : '+');
+			put_cell(gr, x, y, y == zeroY ? '#' : '+', 0);
 		}
 		
 		// Draw labels
-		mvwprintw(gr.win, y, 0, "%.10lg", y0);
+		if(labels){
+			snprintf(buf, sizeof(buf), "%.10lg", y0);
+			gr.tg->print(gr.tg, 0, y, buf, 0);
+		}
 	}
 }
 
@@ -129,96 +148,271 @@ static char pattern_to_char[] = {
 	'-', '`', '\'', ' '  // 12 - 15
 };
 
-// Set and get bits from a bit array 
-#define setbit(ba, i, v) ((char*)ba)[(i) / sizeof(char)] |= ((v) & 0x01) << ((i) % sizeof(char))
-#define getbit(ba, i) ((((char*)ba)[(i) / sizeof(char)] >> ((i) % sizeof(char))) & 0x01)
+void draw_curve(graph_t gr, double (*func)(void*, double, double), void *input, int color){
+	int tw = gr.tg->cols, th = gr.tg->rows; // Store target dimensions
+	
+	// Store signs of the grid points as packed rows
+	size_t stride = signrow_words(tw + 1);
+	uint64_t *signs = malloc((th + 1) * stride * sizeof(uint64_t));
+	// Store x value of each column so it is only calculated once
+	double *pxs = malloc((tw + 1) * sizeof(double));
+	if(!signs || !pxs){
+		free(signs);
+		free(pxs);
+		return;
+	}
+	
+	for(int x = 0; x <= tw; x++) to_graph(gr, x, 0, pxs + x, NULL);
+	
+	// Collect the signs from each point in the grid row by row
+	double py;
+	uint64_t *row = signs;
+	for(int y = 0; y <= th; y++, row += stride){
+		to_graph(gr, 0, y, NULL, &py);
+		for(int x = 0; x <= tw; x++){
+			signrow_put(row, x, func(input, pxs[x], py) >= 0);
+		}
+	}
+	
+	draw_signs(gr, signs, color);
+	
+	free(pxs);
+	free(signs);
+}
 
-void draw_curve(graph_t gr, double (*func)(void*, double, double), void *input){
-	int x, y;
-	int tw, th; // Store terminal window dimensions
-	getmaxyx(gr.win, th, tw);
+// Draw curve from the signs of its function at every lattice point of the graph
+void draw_signs(graph_t gr, const uint64_t *signs, int color){
+	int tw = gr.tg->cols, th = gr.tg->rows;
+	size_t stride = signrow_words(tw + 1);
+	
+	uint64_t corners[4];
+	const uint64_t *upper = signs, *lower = signs + stride;
+	for(int y = 0; y < th; y++){
+		// Classify a word of cells at a time and only visit those the curve passes through
+		for(size_t w = 0; w < stride; w++){
+			uint64_t mixed = signrow_cells(upper, lower, tw, w, corners);
+			while(mixed){
+				int b = __builtin_ctzll(mixed);
+				mixed &= mixed - 1;
+				
+				put_cell(gr, w * SIGNROW_BITS + b, y, pattern_to_char[signrow_pattern(corners, b)], color);
+			}
+		}
+		
+		upper = lower;
+		lower += stride;
+	}
+}
+
+// Bit of the dot in column x and row y of a Braille character
+static const unsigned char braille_dot[2][4] = {
+	{0x01, 0x02, 0x04, 0x40},
+	{0x08, 0x10, 0x20, 0x80}
+};
+
+void draw_braille(graph_t gr, const uint64_t *signs, int color){
+	int tw = gr.tg->cols, th = gr.tg->rows;
+	int dw = 2 * tw;  // Number of dots in a row
+	size_t stride = signrow_words(dw + 1);
+	
+	// Dots raised in each cell of the current row
+	unsigned char *dots = malloc(tw > 0 ? tw : 1);
+	if(!dots) return;
+	
+	uint64_t corners[4];
+	for(int y = 0; y < th; y++){
+		memset(dots, 0, tw);
+		
+		// Each row of cells contains 4 rows of dots
+		for(int dy = 0; dy < 4; dy++){
+			const uint64_t *upper = signs + (size_t)(4 * y + dy) * stride;
+			for(size_t w = 0; w < stride; w++){
+				uint64_t mixed = signrow_cells(upper, upper + stride, dw, w, corners);
+				while(mixed){
+					int dx = w * SIGNROW_BITS + __builtin_ctzll(mixed);
+					mixed &= mixed - 1;
+					
+					dots[dx / 2] |= braille_dot[dx % 2][dy];
+				}
+			}
+		}
+		
+		for(int x = 0; x < tw; x++){
+			if(dots[x]) put_cell(gr, x, y, 0x2800 + dots[x], color);
+		}
+	}
+	
+	free(dots);
+}
+
+// Spacing in cells between the grid lines scanned to find seeds for trace_curve
+#define TRACE_STRIDE 8
+
+// Lattice of lazily evaluated signs used by trace_curve
+struct trace_s{
+	graph_t gr;
+	int tw, th;
 	
-	// Store size of grid in x
-	int sz = (tw + 1) * (th + 1);
-	sz = (sz % sizeof(char) != 0) + sz / sizeof(char);
-	// Create array to store signs of grid points bitwise in memory
-	char ispos[sz];
-	memset(ispos, 0, sz);
+	double (*func)(void*, double, double);
+	void *input;
 	
-	double px, py;
-	int i = 0;
-	// Collect the signs from each point in the grid
-	for(x = 0; x <= tw; x++){
-		to_graph(gr, x, 0, &px, NULL);
-		for(y = 0; y <= th; y++){
-			to_graph(gr, 0, y, NULL, &py);
-			setbit(ispos, i, func(input, px, py) >= 0);
-			i++;
+	// Sign of each lattice point stored column by column (like draw_curve)
+	// 0 -> unevaluated, 1 -> func < 0, 2 -> func >= 0
+	char *signs;
+	// Whether each cell has been queued to be drawn
+	char *queued;
+	// Queue of cell indices (x * th + y) whose patterns need to be drawn
+	int *queue, qlen;
+};
+
+// Get sign (1 or 0) of func at lattice point (x, y) evaluating it if necessary
+static int trace_sign(struct trace_s *tr, int x, int y){
+	char *s = tr->signs + x * (tr->th + 1) + y;
+	if(!*s){
+		double px, py;
+		to_graph(tr->gr, x, y, &px, &py);
+		*s = 1 + (tr->func(tr->input, px, py) >= 0);
+	}
+	return *s - 1;
+}
+
+// Add cell (x, y) to the queue if it exists and hasn't been queued before
+static void trace_push(struct trace_s *tr, int x, int y){
+	if(x < 0 || x >= tr->tw || y < 0 || y >= tr->th) return;
+	
+	int i = x * tr->th + y;
+	if(tr->queued[i]) return;
+	tr->queued[i] = 1;
+	tr->queue[tr->qlen++] = i;
+}
+
+// Draw the queued cells from the head'th on and follow the curve through the edges it crosses
+// Each cell is visited once so closed loops terminate and branches are each followed
+static void trace_follow(struct trace_s *tr, int head, int color){
+	int x, y, a0, a1, a2, a3;
+	for(int i = head; i < tr->qlen; i++){
+		x = tr->queue[i] / tr->th;
+		y = tr->queue[i] % tr->th;
+		
+		// Signs of the corners in the same layout as pattern_to_char
+		a0 = trace_sign(tr, x, y);
+		a1 = trace_sign(tr, x + 1, y);
+		a2 = trace_sign(tr, x, y + 1);
+		a3 = trace_sign(tr, x + 1, y + 1);
+		
+		char ch = pattern_to_char[a3 << 3 | a2 << 2 | a1 << 1 | a0];
+		if(ch != ' ') put_cell(tr->gr, x, y, ch, color);
+		
+		// Move into neighboring cells across edges with a sign change
+		if(a0 != a1) trace_push(tr, x, y - 1);
+		if(a2 != a3) trace_push(tr, x, y + 1);
+		if(a0 != a2) trace_push(tr, x - 1, y);
+		if(a1 != a3) trace_push(tr, x + 1, y);
+	}
+}
+
+// Draw a curve defined by func(x, y) == 0 by following it from cell to cell
+void trace_curve(graph_t gr, double (*func)(void*, double, double), void *input, int color){
+	struct trace_s tr = {.gr = gr, .tw = gr.tg->cols, .th = gr.tg->rows, .func = func, .input = input};
+	if(tr.tw <= 0 || tr.th <= 0) return;
+	
+	tr.signs = calloc((tr.tw + 1) * (tr.th + 1), sizeof(char));
+	tr.queued = calloc(tr.tw * tr.th, sizeof(char));
+	tr.queue = malloc(tr.tw * tr.th * sizeof(int));
+	tr.qlen = 0;
+	
+	int x, y;
+	// Seed queue with cells next to crossings along every TRACE_STRIDE'th column and line
+	// Components crossing these lines are followed from them before the sweep below
+	for(x = 0; x <= tr.tw; x += TRACE_STRIDE){
+		for(y = 0; y < tr.th; y++){
+			if(trace_sign(&tr, x, y) != trace_sign(&tr, x, y + 1)){
+				trace_push(&tr, x - 1, y);
+				trace_push(&tr, x, y);
+			}
 		}
 	}
+	for(y = 0; y <= tr.th; y += TRACE_STRIDE){
+		for(x = 0; x < tr.tw; x++){
+			if(trace_sign(&tr, x, y) != trace_sign(&tr, x + 1, y)){
+				trace_push(&tr, x, y - 1);
+				trace_push(&tr, x, y);
+			}
+		}
+	}
+	trace_follow(&tr, 0, color);
 	
-	char acc;
-	i = 0;
-	for(x = 0; x < tw; x++){
-		for(y = 0; y < th; y++){
-			// Use acc to bitwise accumulate the corners
-			acc = 0;
-			acc |= getbit(ispos, i);
-			acc |= getbit(ispos, i + (th + 1)) << 1;
-			acc |= getbit(ispos, i + 1) << 2;
-			acc |= getbit(ispos, i + (th + 1) + 1) << 3;
+	// Components between the lines (e.g. small loops) aren't reached from the seeds
+	// so the corners of every cell not visited yet are checked for a sign change to follow from
+	for(x = 0; x < tr.tw; x++){
+		for(y = 0; y < tr.th; y++){
+			if(tr.queued[x * tr.th + y]) continue;
 			
-			acc = pattern_to_char[(int)acc];
-			if(acc != ' ') mvwaddch(gr.win, y, x, acc);
+			int corners = trace_sign(&tr, x, y) + trace_sign(&tr, x + 1, y) + trace_sign(&tr, x, y + 1) + trace_sign(&tr, x + 1, y + 1);
+			if(corners == 0 || corners == 4) continue;
 			
-			i++;
+			int head = tr.qlen;
+			trace_push(&tr, x, y);
+			trace_follow(&tr, head, color);
 		}
-		
-		// This loop iterates over one fewer iteration that the above
-		// So it is necessary to move over one more to get to the next row
-		i++;
 	}
+	
+	free(tr.signs);
+	free(tr.queued);
+	free(tr.queue);
+}
+
+// Convert a distance along the graph into the index of the cell containing it
+// The index is clamped to [-1, n] so that far away or infinite values remain drawable
+// Returns false if dist is NaN
+static bool to_cell(double dist, double span, int n, int *cell){
+	if(isnan(dist)) return 0;
+	
+	dist = dist * n / span;
+	if(dist < -1) *cell = -1;
+	else if(dist > n) *cell = n;
+	else *cell = (int) floor(dist);
+	return 1;
 }
 
 // Draw function defined by func(x) = y
 // If isx_out = 1 then func(y) = x
-void draw_func(graph_t gr, double (*func)(void*, double), void *input, bool isx_out){
-	int tw, th;
-	getmaxyx(gr.win, th, tw);
+void draw_func(graph_t gr, double (*func)(void*, double), void *input, bool isx_out, int color){
+	int tw = gr.tg->cols, th = gr.tg->rows;
 	
 	int x, y, top;  // Used to track location of curve in columns and lines
 	double gx, gy;  // Used to track location of curve in terms of units
 	if(isx_out){
 		// Function for x in terms of y
-		for(y = 0; y < tw; y++){
+		for(y = 0; y < th; y++){
 			// Get location of curve at beginning of cell
 			to_graph(gr, 0, y, NULL, &gy);
 			gx = func(input, gy);
-			from_graph(gr, gx, 0, &x, NULL);
+			if(!to_cell(gx - gr.x, gr.wid, tw, &x)) continue;
 			
 			// Get location of curve at end of cell
 			to_graph(gr, 0, y + 1, NULL, &gy);
 			gx = func(input, gy);
-			from_graph(gr, gx, 0, &top, NULL);
+			if(!to_cell(gx - gr.x, gr.wid, tw, &top)) continue;
 			
 			if(top == x){
 				// If top == x then the line passes vertically through the cell
-				mvwaddch(gr.win, y, x, '|');
+				if(0 <= x && x < tw) put_cell(gr, x, y, '|', color);
 				continue;
 			}else{
 				// Draw end pieces of horizontal line
-				if(0 < x && x < tw){
-					mvwaddch(gr.win, y, x, top < x ? '\'' : '`');
+				if(0 <= x && x < tw){
+					put_cell(gr, x, y, top < x ? '\'' : '`', color);
 				}
 				
-				if(0 < top && top < tw){
-					mvwaddch(gr.win, y, top, top < x ? ',' : '.');
+				if(0 <= top && top < tw){
+					put_cell(gr, top, y, top < x ? ',' : '.', color);
 				}
 			}
 			
 			// Draw horizontal line
 			for(top > x ? x++ : x--; x != top; top > x ? x++ : x--){
-				if(0 < x && x < tw) mvwaddch(gr.win, y, x, '-');
+				if(0 <= x && x < tw) put_cell(gr, x, y, '-', color);
 			}
 		}
 	}else{
@@ -227,42 +421,42 @@ void draw_func(graph_t gr, double (*func)(void*, double), void *input, bool isx_
 			// Get location of curve at beginning of cell
 			to_graph(gr, x, 0, &gx, NULL);
 			gy = func(input, gx);
-			from_graph(gr, 0, gy, NULL, &y);
+			if(!to_cell(gr.y - gy, gr.hei, th, &y)) continue;
 			
 			// Get location of curve at end of cell
 			to_graph(gr, x + 1, 0, &gx, NULL);
 			gy = func(input, gx);
-			from_graph(gr, 0, gy, NULL, &top);
+			if(!to_cell(gr.y - gy, gr.hei, th, &top)) continue;
 			
 			if(top == y){
 				// If top == y then the line passes horizontally through the cell
-				mvwaddch(gr.win, y, x, '-');
+				if(0 <= y && y < th) put_cell(gr, x, y, '-', color);
 				continue;
 			}else{
 				// Draw end pieces of vertical line
-				if(0 < y && y < th){
-					mvwaddch(gr.win, y, x, top < y ? '\'' : '.');
+				if(0 <= y && y < th){
+					put_cell(gr, x, y, top < y ? '\'' : '.', color);
 				}
 				
-				if(0 < top && top < th){
-					mvwaddch(gr.win, top, x, top < y ? ',' : '`');
+				if(0 <= top && top < th){
+					put_cell(gr, x, top, top < y ? ',' : '`', color);
 				}
 			}
 			
 			// Draw vertical line
 			for(top > y ? y++ : y--; y != top; top > y ? y++ : y--){
-				if(0 < y && y < th) mvwaddch(gr.win, y, x, '|');
+				if(0 <= y && y < th) put_cell(gr, x, y, '|', color);
 			}
 		}
 	}
 }
 
 
-bool draw_point(graph_t gr, double x, double y, const chtype ch){
+bool draw_point(graph_t gr, double x, double y, int ch, int color){
 	int tx, ty;
 	// When (x, y) is within the bounds of the screen
 	if(from_graph(gr, x, y, &tx, &ty)){
-		mvwaddch(gr.win, ty, tx, ch);
+		put_cell(gr, tx, ty, ch, color);
 		return 1;
 	}
 	return 0;
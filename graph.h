@@ -1,11 +1,37 @@
 #ifndef _GRAPH_H
 #define _GRAPH_H
 
-#include <ncurses.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Methods available for drawing implicit curves
+typedef enum{
+	RENDER_SCAN = 0,  // Evaluate every point in the window (draw_curve)
+	RENDER_TRACE,  // Follow the curve from crossings found on a coarse grid (trace_curve)
+	RENDER_BRAILLE,  // Evaluate a 2x4 grid of dots in every cell drawn with Braille characters (draw_braille)
+	RENDER_COUNT  // Number of renderers
+} render_t;
+
+// Surface of cells that a graph is drawn onto (e.g. an ncurses window or an image)
+typedef struct target_s{
+	// Number of columns and lines of cells in the target
+	int cols, rows;
+	
+	// Place character ch with color pair color in cell (x, y)
+	// ch is a Unicode code point which is only outside of ASCII for Braille characters
+	// Cells outside of the target should be ignored
+	void (*put)(struct target_s *tg, int x, int y, int ch, int color);
+	// Write str starting at cell (x, y) with color pair color
+	// NULL if the target cannot display text (e.g. images)
+	void (*print)(struct target_s *tg, int x, int y, const char *str, int color);
+	
+	// Data specific to the kind of target
+	void *data;
+} target_t;
 
 typedef struct{
-	// Ncurses window to draw graph to
-	WINDOW* win;
+	// Target to draw graph to
+	target_t *tg;
 	
 	// Define the characteristics of the graph within the plane
 	// X, Y coordinate of the left corner within the plane
@@ -28,15 +54,31 @@ void zoom_graph(graph_t *gr, double scaleX, double scaleY);
 // Set the width and height of the viewport while keeping the center where it is
 void setdims_graph(graph_t *gr, double w, double h);
 
-// x, y, w, h describe the position and size of the graph in the window
+// Calculate the spacing in units between vertical (cw) and horizontal (ch) gridlines
+void grid_spacing(graph_t gr, double *cw, double *ch);
+// Draw gridlines using spacing calculated by grid_spacing
 void draw_gridlines(graph_t gr);
+// Draw gridlines placed at every multiple of cw horizontally and ch vertically
+void draw_gridlines_at(graph_t gr, double cw, double ch);
+
+// All of the following draw using the color pair color
 // Draw a curve defined by func(x, y) == 0
-void draw_curve(graph_t gr, double (*func)(void*, double, double), void *input);
+void draw_curve(graph_t gr, double (*func)(void*, double, double), void *input, int color);
+// Draw a curve from the signs of its function at each lattice point of the graph
+// Signs are packed rows (see signgrid.h) from the top with cols + 1 points in each of the rows + 1 rows
+void draw_signs(graph_t gr, const uint64_t *signs, int color);
+// Draw a curve from its signs on a lattice with 2 columns and 4 rows of dots in every cell of the graph
+// Signs are packed rows from the top with 2 * cols + 1 points in each of the 4 * rows + 1 rows
+// Each dot the curve passes through is raised in the Braille character (U+2800 - U+28FF) of its cell
+void draw_braille(graph_t gr, const uint64_t *signs, int color);
+// Draw a curve defined by func(x, y) == 0 by tracing it from crossings found on a coarse grid
+// The cells the tracing doesn't reach are then swept so components that fit between the grid lines are traced too
+void trace_curve(graph_t gr, double (*func)(void*, double, double), void *input, int color);
 // Draw function defined by func(x) = y
 // If isx_out = 1 then func(y) = x
-void draw_func(graph_t gr, double (*func)(void*, double), void *input, bool isx_out);
+void draw_func(graph_t gr, double (*func)(void*, double), void *input, bool isx_out, int color);
 // Draw point at (x, y) using the provided character
 // Returns whether the point fell within the bounds of the graph
-bool draw_point(graph_t gr, double x, double y, const chtype ch);
+bool draw_point(graph_t gr, double x, double y, int ch, int color);
 
 #endif
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+
+#include "image.h"
+
+// Colors (RGB) of the background and gridlines
+#define BACKGROUND_COLOR 0xff
+#define GRIDLINE_COLOR 0xd8
+#define AXIS_COLOR 0x80
+
+// Colors (RGB) used for each color pair of the curves
+static const unsigned char pair_colors[][3] = {
+	{0x00, 0x00, 0x00},  // Default pair used by text
+	{0xdc, 0x1e, 0x1e},  // Red
+	{0x1e, 0xa0, 0x1e},  // Green
+	{0x28, 0x3c, 0xdc},  // Blue
+	{0x14, 0xaa, 0xbe},  // Cyan
+	{0xd2, 0xaa, 0x00},  // Yellow
+	{0xbe, 0x28, 0xbe}   // Magenta
+};
+
+// Largest amount of data that fits in one stored deflate block
+#define STORED_BLOCK_SIZE 65535
+// Largest number of bytes that can be summed before the Adler-32 sums must be reduced
+#define ADLER_RUN 5552
+
+struct image_s{
+	FILE *file;
+	bool png;
+	int width;
+	
+	// Band of pixels currently being rendered
+	// Stored row by row with three bytes (RGB) per pixel
+	unsigned char *pixels;
+	
+	// PNG output state
+	// Scanline (filter byte followed by the pixels of the row) and IDAT chunk being built
+	unsigned char *scanline, *chunk;
+	// Running Adler-32 checksum of the uncompressed scanlines
+	uint32_t adler_a, adler_b;
+};
+
+
+
+// Color a pixel in the current band
+static void image_put(target_t *tg, int x, int y, int ch, int color){
+	if(x < 0 || x >= tg->cols || y < 0 || y >= tg->rows) return;
+	
+	struct image_s *img = tg->data;
+	unsigned char *px = img->pixels + 3 * ((size_t)y * img->width + x);
+	
+	color &= ~INVERT_PAIR;
+	if(color == 0){
+		// Gridlines are drawn in the default color pair
+		// The axes are distinguished by the characters used for them
+		px[0] = px[1] = px[2] = ch == '$' || ch == '=' || ch == '#' ? AXIS_COLOR : GRIDLINE_COLOR;
+	}else if(color < (int)(sizeof(pair_colors) / sizeof(pair_colors[0]))){
+		memcpy(px, pair_colors[color], 3);
+	}
+}
+
+
+
+// Table for calculating the CRC-32 used by PNG chunks
+static uint32_t crc_table[256];
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char *buf, size_t len){
+	// Generate table on first use
+	if(!crc_table[1]){
+		for(uint32_t n = 0; n < 256; n++){
+			uint32_t c = n;
+			for(int k = 0; k < 8; k++){
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			}
+			crc_table[n] = c;
+		}
+	}
+	
+	crc = ~crc;
+	for(size_t i = 0; i < len; i++){
+		crc = crc_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+// Store 32-bit integer in big-endian byte order
+static void put_be32(unsigned char *buf, uint32_t v){
+	buf[0] = v >> 24;
+	buf[1] = v >> 16;
+	buf[2] = v >> 8;
+	buf[3] = v;
+}
+
+// Write a PNG chunk with the given four character type
+static void write_chunk(FILE *file, const char *type, const unsigned char *data, size_t len){
+	unsigned char buf[4];
+	put_be32(buf, (uint32_t)len);
+	fwrite(buf, 1, 4, file);
+	fwrite(type, 1, 4, file);
+	if(len > 0) fwrite(data, 1, len, file);
+	
+	uint32_t crc = crc32_update(0, (const unsigned char*)type, 4);
+	put_be32(buf, crc32_update(crc, data, len));
+	fwrite(buf, 1, 4, file);
+}
+
+// Write one row of pixels to the image file
+static void write_row(struct image_s *img, const unsigned char *row, bool first, bool last){
+	size_t rowlen = 3 * (size_t)img->width;
+	if(!img->png){
+		fwrite(row, 1, rowlen, img->file);
+		return;
+	}
+	
+	// Scanline uses no filter
+	unsigned char *scan = img->scanline;
+	scan[0] = 0;
+	memcpy(scan + 1, row, rowlen);
+	rowlen++;
+	
+	// Update Adler-32 checksum of the zlib stream
+	for(size_t i = 0; i < rowlen; i += ADLER_RUN){
+		size_t end = i + ADLER_RUN < rowlen ? i + ADLER_RUN : rowlen;
+		for(size_t j = i; j < end; j++){
+			img->adler_a += scan[j];
+			img->adler_b += img->adler_a;
+		}
+		img->adler_a %= 65521;
+		img->adler_b %= 65521;
+	}
+	
+	// Each scanline is placed into its own IDAT chunk as uncompressed deflate blocks
+	unsigned char *c = img->chunk;
+	if(first){
+		// zlib header for deflate with no compression
+		*c++ = 0x78;
+		*c++ = 0x01;
+	}
+	for(size_t i = 0; i < rowlen; i += STORED_BLOCK_SIZE){
+		size_t len = rowlen - i < STORED_BLOCK_SIZE ? rowlen - i : STORED_BLOCK_SIZE;
+		// Mark final block of the stream
+		*c++ = last && i + len == rowlen;
+		*c++ = len & 0xff;
+		*c++ = len >> 8;
+		*c++ = ~len & 0xff;
+		*c++ = (~len >> 8) & 0xff;
+		memcpy(c, scan + i, len);
+		c += len;
+	}
+	if(last){
+		put_be32(c, img->adler_b << 16 | img->adler_a);
+		c += 4;
+	}
+	
+	write_chunk(img->file, "IDAT", img->chunk, (size_t)(c - img->chunk));
+}
+
+static void write_header(struct image_s *img, int width, int height){
+	if(!img->png){
+		fprintf(img->file, "P6\n%d %d\n255\n", width, height);
+		return;
+	}
+	
+	static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	fwrite(signature, 1, 8, img->file);
+	
+	// 8-bit RGB without interlacing
+	unsigned char ihdr[13] = {0};
+	put_be32(ihdr, (uint32_t)width);
+	put_be32(ihdr + 4, (uint32_t)height);
+	ihdr[8] = 8;
+	ihdr[9] = 2;
+	write_chunk(img->file, "IHDR", ihdr, sizeof(ihdr));
+}
+
+
+
+bool render_image(const char *path, graph_t gr, int width, int height, equat_t gallery, render_t renderer){
+	if(width <= 0 || height <= 0) return 0;
+	
+	struct image_s img = {0};
+	img.file = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+	if(!img.file) return 0;
+	
+	size_t pathlen = strlen(path);
+	img.png = pathlen >= 4 && strcasecmp(path + pathlen - 4, ".png") == 0;
+	img.width = width;
+	img.pixels = malloc(3 * (size_t)width * IMAGE_BAND_ROWS);
+	if(img.png){
+		size_t rowlen = 3 * (size_t)width + 1;
+		img.scanline = malloc(rowlen);
+		// Space for zlib header, block headers, scanline, and checksum
+		img.chunk = malloc(2 + 5 * (rowlen / STORED_BLOCK_SIZE + 1) + rowlen + 4);
+		img.adler_a = 1;
+		img.adler_b = 0;
+	}
+	write_header(&img, width, height);
+	
+	// Spacing of gridlines depends on the whole image rather than each band
+	double cw, ch;
+	grid_spacing(gr, &cw, &ch);
+	
+	// Signs of the curves in each band are sampled together and the memory reused between bands
+	signgrid_t grid = {0};
+	
+	// Each band is drawn as a graph of the strip of the plane it covers
+	target_t tg = {width, 0, image_put, NULL, &img};
+	graph_t band = gr;
+	band.tg = &tg;
+	for(int top = 0; top < height; top += IMAGE_BAND_ROWS){
+		tg.rows = height - top < IMAGE_BAND_ROWS ? height - top : IMAGE_BAND_ROWS;
+		band.y = gr.y - top * gr.hei / height;
+		band.hei = tg.rows * gr.hei / height;
+		
+		memset(img.pixels, BACKGROUND_COLOR, 3 * (size_t)width * tg.rows);
+		draw_gridlines_at(band, cw, ch);
+		draw_curves(band, gallery, renderer, &grid);
+		
+		for(int y = 0; y < tg.rows; y++){
+			write_row(&img, img.pixels + 3 * (size_t)width * y, top + y == 0, top + y == height - 1);
+		}
+	}
+	
+	if(img.png) write_chunk(img.file, "IEND", NULL, 0);
+	
+	bool success = !ferror(img.file);
+	if(img.file == stdout) fflush(stdout);
+	else if(fclose(img.file) != 0) success = 0;
+	
+	signgrid_free(&grid);
+	free(img.pixels);
+	free(img.scanline);
+	free(img.chunk);
+	return success;
+}
@@ -0,0 +1,30 @@
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include <stdbool.h>
+
+#include "graph.h"
+#include "gallery.h"
+
+// Number of rows of pixels rendered at once before being written out
+#define IMAGE_BAND_ROWS 64
+
+/* Render the gridlines and curves of gallery to an image file without a terminal
+ * Every pixel is treated as a cell so the image is width by height cells
+ * The image is rendered and streamed out in bands of IMAGE_BAND_ROWS rows
+ * so memory use only depends on the width
+ * 
+ * Arguments:
+ *   const char *path : File to write image to or "-" for stdout
+ *     If path ends in ".png" then a PNG is written and otherwise a binary PPM
+ *   graph_t gr : Region of the plane to render (gr.tg is ignored)
+ *   int width, int height : Dimensions of image in pixels
+ *   equat_t gallery : Equations whose curves should be drawn
+ *   render_t renderer : Method used to draw implicit curves
+ * 
+ * Returns:
+ *   bool : Whether the image was successfully written
+ */
+bool render_image(const char *path, graph_t gr, int width, int height, equat_t gallery, render_t renderer);
+
+#endif
@@ -2,12 +2,19 @@
 #include <math.h>
 
 #include "intersect.h"
+#include "signgrid.h"
+#include "stats.h"
+#include "trace.h"
 
 // Store current functions
 static double (*fn1)(void*, double, double) = NULL;
 static double (*fn2)(void*, double, double) = NULL;
 // Store their parameters;
 static void *prm1, *prm2;
+// Store their signs at the lattice points if they were provided
+static const uint64_t *sgn1, *sgn2;
+// Number of words in each packed row of signs
+static size_t stride;
 
 
 
@@ -43,6 +50,7 @@ static struct triag_s invert_triag(struct triag_s tr){
 
 // Return value indicating if f1(x, y) <= 0 or f1(x, y) > 0 as well as f2(x, y) <= 0 or f2(x, y) > 0
 static char check_point(point_t pt){
+	stats.check_points++;
 	char val = 0;
 	
 	// Store f2 info in second LSB
@@ -54,6 +62,25 @@ static char check_point(point_t pt){
 	return val;
 }
 
+// Same as check_point but for the lattice point in the given row and column
+// Uses the signs from the lattice when they are available
+static char check_lattice(point_t pt, int row, int col){
+	if(!sgn1 && !sgn2) return check_point(pt);
+	
+	size_t i = (size_t)row * stride;
+	char val = 0;
+	val |= (sgn1 ? signrow_get(sgn1 + i, col) : fn1(prm1, pt.x, pt.y) <= 0) & 0x1;
+	val <<= 1;
+	val |= (sgn2 ? signrow_get(sgn2 + i, col) : fn2(prm2, pt.x, pt.y) <= 0) & 0x1;
+	
+	return val;
+}
+
+// Rows of the lattice store the signs of f1 in a packed row followed by the signs of f2
+// Get and set check_point values in column i of lattice row r
+#define row_get(r, i) (signrow_get((r), (i)) << 1 | signrow_get((r) + stride, (i)))
+#define row_put(r, i, chk) (signrow_put((r), (i), (chk) >> 1), signrow_put((r) + stride, (i), (chk)))
+
 // Checks if triangle contains both curves using check_point return value
 #define check_triag(ach, bch, cch) (((ach) ^ (bch)) == 0b11 || ((bch) ^ (cch)) == 0b11 || ((cch) ^ (ach)) == 0b11)
 
@@ -66,12 +93,16 @@ static char check_point(point_t pt){
  *   char c_chk : ''                                tr.c
  *      NOTE: a_chk, b_chk, c_chk are provided to reduce redundant calculations
  *   int depth : Number of halvings to perform on tr
+ *   int level : Number of calls to isolate_inter this one is nested within
  * 
  * Returns:
  *   point_t : Location of crossing
  *   bool *success : Whether a crossing was in fact present in tr
  */
-static point_t isolate_inter(struct triag_s tr, char a_chk, char b_chk, char c_chk, int depth, bool *success){
+static point_t isolate_inter(struct triag_s tr, char a_chk, char b_chk, char c_chk, int depth, int level, bool *success){
+	stats.isolates++;
+	if(level > stats.isolate_depth) stats.isolate_depth = level;
+	
 	struct triag_s htr;
 	
 	// Store the result of check_point for each vertex in htr
@@ -122,6 +153,7 @@ static point_t isolate_inter(struct triag_s tr, char a_chk, char b_chk, char c_c
 			point_t pt = {0, 0};
 			return pt;
 		}else{  // Multiple sub-triangles contain both curves
+			stats.isolate_branches++;
 			point_t pt;
 			struct triag_s ntr;  // Triangle to be passed to recursive call
 			
@@ -131,7 +163,7 @@ static point_t isolate_inter(struct triag_s tr, char a_chk, char b_chk, char c_c
 				ntr.b = htr.b;
 				ntr.c = htr.c;
 				
-				pt = isolate_inter(ntr, a_chk, hb_chk, hc_chk, depth, success);
+				pt = isolate_inter(ntr, a_chk, hb_chk, hc_chk, depth, level + 1, success);
 				if(*success) return pt;
 			}
 			
@@ -141,7 +173,7 @@ static point_t isolate_inter(struct triag_s tr, char a_chk, char b_chk, char c_c
 				ntr.b = tr.b;
 				ntr.c = htr.c;
 				
-				pt = isolate_inter(ntr, ha_chk, b_chk, hc_chk, depth, success);
+				pt = isolate_inter(ntr, ha_chk, b_chk, hc_chk, depth, level + 1, success);
 				if(*success) return pt;
 			}
 			
@@ -151,7 +183,7 @@ static point_t isolate_inter(struct triag_s tr, char a_chk, char b_chk, char c_c
 				ntr.b = htr.b;
 				ntr.c = tr.c;
 				
-				pt = isolate_inter(ntr, ha_chk, hb_chk, c_chk, depth, success);
+				pt = isolate_inter(ntr, ha_chk, hb_chk, c_chk, depth, level + 1, success);
 				if(*success) return pt;
 			}
 			
@@ -161,7 +193,7 @@ static point_t isolate_inter(struct triag_s tr, char a_chk, char b_chk, char c_c
 				ntr.b = htr.b;
 				ntr.c = htr.c;
 				
-				pt = isolate_inter(ntr, ha_chk, hb_chk, hc_chk, depth, success);
+				pt = isolate_inter(ntr, ha_chk, hb_chk, hc_chk, depth, level + 1, success);
 				if(*success) return pt;
 			}
 			
@@ -188,7 +220,7 @@ point_t curve_inters(
 	int depth, bool *success
 ){
 	// Store prior and current row of check points
-	static char *priorRow, *currRow;
+	static uint64_t *priorRow, *currRow;
 	/* Grid Example ; Center=(0,0) Width,Height=(2,2) Rows,Cols=(4,4)
 	 *   '*' represents grid points in memory
 	 *   '.' represents grid points out of memory
@@ -211,6 +243,7 @@ point_t curve_inters(
 	static double cwid, chei;  // Distance between consecutive columns and rows, respectively
 	static point_t loc;  // Position of current lattice point
 	static int col, rowlen;  // The Column Index of current lattive point in currRow and the maximum column index (i.e. row length)
+	static int row, lastrow;  // The Row Index of currRow and the index of the last row
 	static double minx, miny;  // A Lower Bound for the x and y values of loc
 	static bool checking_upper, skip_lower;  // Whether the upper triangle is being checked and whether the lower triangle should be skipped
 	
@@ -226,11 +259,15 @@ point_t curve_inters(
 		// Set function parameters
 		prm1 = inp1;
 		prm2 = inp2;
+		// Set precomputed signs
+		sgn1 = rect.signs1;
+		sgn2 = rect.signs2;
 		
-		// Allocate rowlen number of char's for currRow and priorRow
+		// Allocate packed rows of rowlen signs of each function for currRow and priorRow
 		rowlen = rect.columns + 1;
-		priorRow = malloc(sizeof(char) * rowlen);
-		currRow = malloc(sizeof(char) * rowlen);
+		stride = signrow_words(rowlen);
+		priorRow = malloc(sizeof(uint64_t) * 2 * stride);
+		currRow = malloc(sizeof(uint64_t) * 2 * stride);
 		// Set loc to the top left corner
 		loc.x = rect.x;
 		loc.y = rect.y;
@@ -241,17 +278,20 @@ point_t curve_inters(
 		minx = rect.x;
 		miny = rect.y - rect.height - chei / 2;  // miny must be slightly lower than grid to ensure proper detection of end condition
 		
+		lastrow = rect.rows;
+		
 		// Iterate through first row to calculate priorRow values
 		for(col = 0; col < rowlen; col++){
-			priorRow[col] = check_point(loc);
+			row_put(priorRow, col, check_lattice(loc, 0, col));
 			loc.x += cwid;
 		}
 		
 		// Move to first grid point in currRow
 		loc.x = minx;
 		loc.y -= chei;
+		row = 1;
 		// Calculate first value of currRow
-		currRow[0] = check_point(loc);
+		row_put(currRow, 0, check_lattice(loc, row, 0));
 		
 		// Move to next grid point after first
 		col = 1;
@@ -285,11 +325,12 @@ point_t curve_inters(
 		
 		if(checking_upper){
 			// Check current grid point
-			currRow[col] = check_point(loc);
+			row_put(currRow, col, check_lattice(loc, row, col));
 			
 			checking_upper = 0;
 			// Check upper triangle
-			if(check_triag(currRow[col - 1], priorRow[col], priorRow[col - 1])){
+			char cl = row_get(currRow, col - 1), pc = row_get(priorRow, col), pl = row_get(priorRow, col - 1);
+			if(check_triag(cl, pc, pl)){
 				tr.a.x = loc.x - cwid;
 				tr.a.y = loc.y;
 				tr.b.x = loc.x;
@@ -297,12 +338,13 @@ point_t curve_inters(
 				tr.c.x = loc.x - cwid;
 				tr.c.y = loc.y + chei;
 				
-				pt = isolate_inter(tr, currRow[col - 1], priorRow[col], priorRow[col - 1], depth, success);
+				pt = isolate_inter(tr, cl, pc, pl, depth, 0, success);
 				if(*success) return pt;
 			}
 		}else{
 			// Check lower triangle
-			if(!skip_lower && check_triag(priorRow[col], currRow[col], currRow[col - 1])){
+			char pc = row_get(priorRow, col), cc = row_get(currRow, col), cl = row_get(currRow, col - 1);
+			if(!skip_lower && check_triag(pc, cc, cl)){
 				// Indicate that when the 
 				skip_lower = 1;
 				
@@ -313,7 +355,7 @@ point_t curve_inters(
 				tr.c.x = loc.x - cwid;
 				tr.c.y = loc.y;
 				
-				pt = isolate_inter(tr, priorRow[col], currRow[col], currRow[col - 1], depth, success);
+				pt = isolate_inter(tr, pc, cc, cl, depth, 0, success);
 				if(*success) return pt;
 			}
 			
@@ -331,15 +373,16 @@ point_t curve_inters(
 				// Reset loc to beginning of currRow when it reaches the end 
 				loc.x = minx;
 				loc.y -= chei;
+				row++;
 				
 				// Move currRow to priorRow
-				char *tmp;
+				uint64_t *tmp;
 				tmp = priorRow;
 				priorRow = currRow;
 				currRow = tmp;
 				
-				// Check first value in row
-				currRow[col] = check_point(loc);
+				// Check first value in row unless the lattice has been exhausted
+				if(row <= lastrow) row_put(currRow, col, check_lattice(loc, row, col));
 				// Move to next point
 				col++;
 				loc.x += cwid;
@@ -376,6 +419,7 @@ inter_t append_inters(
 	bool success;
 	point_t pt;
 	inter_t new_inter;
+	trace_begin("append_inters", NULL);
 	pt = curve_inters(rect, f1, inp1, f2, inp2, depth, &success);
 	
 	// Insert intersection points into inters while more are found
@@ -410,6 +454,7 @@ inter_t append_inters(
 		pt = curve_inters(rect, NULL, NULL, NULL, NULL, depth, &success);
 	}
 	
+	trace_end("append_inters");
 	return *inters;
 }
 
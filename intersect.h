@@ -2,6 +2,7 @@
 #define _INTERSECT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 // Rectangle in which to search using a lattice of points with a certain number of rows and columns
 struct bound_s{
@@ -10,6 +11,11 @@ struct bound_s{
 	double width, height;
 	
 	int rows, columns;
+	
+	// Optional signs of f1 and f2 already sampled at the lattice points (see signgrid.h)
+	// Stored as packed rows (from the top) of f(x, y) <= 0 with columns + 1 points per row
+	// If NULL then the function is evaluated at each lattice point instead
+	const uint64_t *signs1, *signs2;
 };
 
 // Point within the (x, y) plane
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "libskedia.h"
+#include "gallery.h"
+#include "intersect.h"
+#include "signgrid.h"
+
+// State of the text of an equation
+enum{
+	STATE_NEW = 0,  // Added but not parsed yet
+	STATE_COMPILED,  // Parsed by sk_compile
+	STATE_CHANGED  // Text replaced since it was parsed
+};
+
+struct sk_gallery_s{
+	// Linked list of equations and the last of them to append after
+	equat_t gallery, tail;
+	// First equation added since the last compile
+	// New equations are always at the end of the gallery so they can be parsed together
+	equat_t first_new;
+	
+	// Equation and state of each id, the equation is NULL if it was removed
+	equat_t *ids;
+	unsigned char *states;
+	size_t count, cap;
+	
+	// Signs of the curves being intersected, reused between searches
+	signgrid_t grid;
+};
+
+// Set while a gallery exists since the names of variables are kept in module state by gallery.c
+static bool exists = 0;
+
+
+
+// Find the equation of id in g
+static equat_t find_id(sk_gallery_t *g, int id){
+	if(id < 0 || (size_t)id >= g->count) return NULL;
+	return g->ids[id];
+}
+
+// Check that id is a curve which can be evaluated
+// Returns SK_OK or the reason it can't be
+static int check_curve(sk_gallery_t *g, int id){
+	equat_t eq = find_id(g, id);
+	if(!eq) return SK_ERR_ID;
+	if(g->states[id] != STATE_COMPILED || eq->err != ERR_OK || !(eq->right)) return SK_ERR_PARSE;
+	if(eq->is_variable) return SK_ERR_NOT_CURVE;
+	return SK_OK;
+}
+
+sk_gallery_t *sk_gallery_new(void){
+	if(exists) return NULL;
+	
+	sk_gallery_t *g = calloc(1, sizeof(sk_gallery_t));
+	if(g) exists = 1;
+	return g;
+}
+
+void sk_gallery_free(sk_gallery_t *g){
+	if(!g) return;
+	
+	// Remove from the end since equations tend to use those before them
+	while(g->tail){
+		equat_t prev = g->tail->prev;
+		remove_equat(&(g->gallery), g->tail);
+		g->tail = prev;
+	}
+	
+	signgrid_free(&(g->grid));
+	free(g->ids);
+	free(g->states);
+	free(g);
+	exists = 0;
+}
+
+int sk_add(sk_gallery_t *g, const char *text){
+	if(g->count == g->cap){
+		size_t cap = g->cap ? 2 * g->cap : 64;
+		equat_t *ids = realloc(g->ids, cap * sizeof(equat_t));
+		if(!ids) return SK_ERR_NOMEM;
+		g->ids = ids;
+		unsigned char *states = realloc(g->states, cap);
+		if(!states) return SK_ERR_NOMEM;
+		g->states = states;
+		g->cap = cap;
+	}
+	
+	equat_t eq = append_equat(&(g->gallery), g->tail, text);
+	if(!eq) return SK_ERR_NOMEM;
+	g->tail = eq;
+	if(!(g->first_new)) g->first_new = eq;
+	
+	g->ids[g->count] = eq;
+	g->states[g->count] = STATE_NEW;
+	return g->count++;
+}
+
+int sk_set(sk_gallery_t *g, int id, const char *text){
+	equat_t eq = find_id(g, id);
+	if(!eq) return SK_ERR_ID;
+	if(!set_equat_text(eq, text)) return SK_ERR_NOMEM;
+	
+	// New equations are parsed with the others added since the last compile
+	if(g->states[id] != STATE_NEW) g->states[id] = STATE_CHANGED;
+	return SK_OK;
+}
+
+int sk_remove(sk_gallery_t *g, int id){
+	equat_t eq = find_id(g, id);
+	if(!eq) return SK_ERR_ID;
+	
+	if(g->tail == eq) g->tail = eq->prev;
+	if(g->first_new == eq) g->first_new = eq->next;
+	remove_equat(&(g->gallery), eq);
+	g->ids[id] = NULL;
+	
+	// The equations using eq were reparsed and a new one could take its place in memory
+	signgrid_free(&(g->grid));
+	return SK_OK;
+}
+
+int sk_compile(sk_gallery_t *g){
+	// Changed equations are reparsed one at a time along with the equations using them
+	for(size_t id = 0; id < g->count; id++){
+		if(g->ids[id] && g->states[id] == STATE_CHANGED){
+			parse_equat(g->gallery, g->ids[id]);
+			g->states[id] = STATE_COMPILED;
+		}
+	}
+	
+	// New equations are parsed together so they may reference each other in any order
+	if(g->first_new){
+		parse_equats(g->gallery, g->first_new);
+		g->first_new = NULL;
+		for(size_t id = 0; id < g->count; id++){
+			if(g->states[id] == STATE_NEW) g->states[id] = STATE_COMPILED;
+		}
+	}
+	
+	// Equations were reparsed so their old signs no longer apply
+	signgrid_free(&(g->grid));
+	
+	int failed = 0;
+	for(equat_t eq = g->gallery; eq; eq = eq->next) if(eq->err != ERR_OK) failed++;
+	return failed;
+}
+
+const char *sk_parse_error(sk_gallery_t *g, int id){
+	equat_t eq = find_id(g, id);
+	if(!eq || g->states[id] != STATE_COMPILED || eq->err == ERR_OK) return NULL;
+	return parse_errstr[eq->err];
+}
+
+const char *sk_strerror(int err){
+	switch(err){
+		case SK_OK: return "Success";
+		case SK_ERR_NOMEM: return "Memory could not be allocated";
+		case SK_ERR_ID: return "No equation has the id";
+		case SK_ERR_PARSE: return "The equation could not be parsed";
+		case SK_ERR_EXISTS: return "A gallery already exists";
+		case SK_ERR_NOT_CURVE: return "The equation is not a curve";
+		case SK_ERR_ARG: return "An argument is out of range";
+		default: return "Unknown error";
+	}
+}
+
+int sk_eval(sk_gallery_t *g, int id, const double *xs, const double *ys, size_t n, double *out){
+	int err = check_curve(g, id);
+	if(err != SK_OK) return err;
+	
+	equat_t eq = g->ids[id];
+	for(size_t i = 0; i < n; i++) out[i] = eval_equat(eq, xs[i], ys[i]);
+	return SK_OK;
+}
+
+int sk_intersect(
+	sk_gallery_t *g, int id1, int id2,
+	double x, double y, double width, double height, int cols, int rows,
+	sk_point_t *pts, size_t max
+){
+	int err = check_curve(g, id1);
+	if(err == SK_OK) err = check_curve(g, id2);
+	if(err != SK_OK) return err;
+	if(id1 == id2 || !(width > 0) || !(height > 0) || cols <= 0 || rows <= 0) return SK_ERR_ARG;
+	
+	// Sample both curves together unless they were on this lattice for the last search
+	equat_t eqs[2] = {g->ids[id1], g->ids[id2]};
+	struct bound_s rect = {.x = x, .y = y, .width = width, .height = height, .rows = rows, .columns = cols};
+	rect.signs1 = signgrid_find(&(g->grid), rect, eqs[0]);
+	rect.signs2 = signgrid_find(&(g->grid), rect, eqs[1]);
+	if(!(rect.signs1) || !(rect.signs2)){
+		sample_equats(&(g->grid), rect, eqs, 2);
+		if(g->grid.count != 2) return SK_ERR_NOMEM;
+		rect.signs1 = signgrid_plane(&(g->grid), 0);
+		rect.signs2 = signgrid_plane(&(g->grid), 1);
+	}
+	
+	// Same depth and precision as skedia -x
+	inter_t inters = NULL;
+	append_inters(
+		&inters, rect,
+		eval_equat, eqs[0],
+		eval_equat, eqs[1],
+		30, (width < height ? width : height) / 10000
+	);
+	
+	int found = 0;
+	if(inters){
+		inter_t inr = inters;
+		do{
+			if((size_t)found < max) pts[found] = (sk_point_t){inr->x, inr->y};
+			found++;
+			
+			inr = inr->next;
+		}while(inr != inters);
+		free_inters(inters);
+	}
+	return found;
+}
@@ -0,0 +1,122 @@
+#ifndef _LIBSKEDIA_H
+#define _LIBSKEDIA_H
+
+#include <stddef.h>
+
+/* Interface of libskedia for embedding the equation engine of skedia in other programs
+ * Only this header is needed to use libskedia.so or libskedia.a (link with -lskedia -lm)
+ *
+ * Equations are added to a gallery exactly as they would be typed into a textbox of skedia:
+ *   curves:    "x^2 + y^2 = r * w"
+ *   variables: "w := sin(x) + 2"
+ *   functions: "f(a, b) := a * b"
+ * and are identified by the id returned when they are added
+ *
+ * Added and changed equations are parsed by sk_compile which resolves the variables and functions
+ * they reference in any order, so an equation may use a variable defined after it
+ *
+ * Usage:
+ *   sk_gallery_t *g = sk_gallery_new();
+ *   int circle = sk_add(g, "x^2 + y^2 = 9");
+ *   int wave = sk_add(g, "y = a * sin(x)");
+ *   sk_add(g, "a := 2");
+ *   if(sk_compile(g) != 0){
+ *       // sk_parse_error(g, id) describes the error of each equation that failed
+ *   }
+ *
+ *   sk_point_t pts[16];
+ *   int n = sk_intersect(g, circle, wave, -5, 5, 10, 10, 500, 500, pts, 16);
+ *   sk_gallery_free(g);
+ *
+ * The engine keeps module state, so only one gallery may exist at a time
+ * and the functions must not be called from several threads at once
+ */
+
+// Symbols of the interface are the only ones exported from libskedia.so
+#define SK_API __attribute__((visibility("default")))
+
+// Return values of the functions
+#define SK_OK 0
+#define SK_ERR_NOMEM -1  // Memory could not be allocated
+#define SK_ERR_ID -2  // No equation has the id
+#define SK_ERR_PARSE -3  // The equation could not be parsed
+#define SK_ERR_EXISTS -4  // A gallery already exists
+#define SK_ERR_NOT_CURVE -5  // The equation defines a variable or function instead of a curve
+#define SK_ERR_ARG -6  // An argument is out of range
+
+// Equations being embedded
+typedef struct sk_gallery_s sk_gallery_t;
+
+// Point within the (x, y) plane
+typedef struct{
+	double x, y;
+} sk_point_t;
+
+// Create an empty gallery
+// Returns NULL if memory could not be allocated or a gallery already exists
+SK_API sk_gallery_t *sk_gallery_new(void);
+// Deallocate g and all of its equations
+SK_API void sk_gallery_free(sk_gallery_t *g);
+
+/* Add an equation with the given text to the end of g
+ * It is not usable until sk_compile is called
+ *
+ * Returns:
+ *   int : Id of the equation (ids are given out from 0 and never reused)
+ *     or SK_ERR_NOMEM
+ */
+SK_API int sk_add(sk_gallery_t *g, const char *text);
+// Replace the text of the equation id which is parsed again by the next sk_compile
+// Returns SK_OK, SK_ERR_ID, or SK_ERR_NOMEM
+SK_API int sk_set(sk_gallery_t *g, int id, const char *text);
+// Remove the equation id, those referencing it are parsed again immediately
+// Returns SK_OK or SK_ERR_ID
+SK_API int sk_remove(sk_gallery_t *g, int id);
+
+/* Parse every equation added or changed since the last call
+ * Equations referencing a changed variable or function are parsed again as well
+ *
+ * Returns:
+ *   int : Number of equations in g which failed to parse (0 if all of them are usable)
+ */
+SK_API int sk_compile(sk_gallery_t *g);
+// Describe the error the equation id failed to parse with (e.g. "ERR_PARENTH_MISMATCH")
+// Returns NULL if it was parsed successfully or hasn't been compiled yet
+SK_API const char *sk_parse_error(sk_gallery_t *g, int id);
+// Describe one of the SK_ERR return values
+SK_API const char *sk_strerror(int err);
+
+/* Evaluate the curve id at n points as its left side minus its right side
+ * The curve passes through the points where the value is 0
+ *
+ * Arguments:
+ *   const double *xs, const double *ys : Coordinates of the points
+ *   size_t n : Number of points
+ *   double *out : Set to the n values
+ *
+ * Returns:
+ *   int : SK_OK, SK_ERR_ID, SK_ERR_PARSE, or SK_ERR_NOT_CURVE
+ */
+SK_API int sk_eval(sk_gallery_t *g, int id, const double *xs, const double *ys, size_t n, double *out);
+
+/* Find the intersections of the curves id1 and id2 within a rectangle of the plane
+ * Crossings are found on a lattice of cols by rows cells and then refined
+ *
+ * Arguments:
+ *   double x, double y : Upper left corner of the rectangle
+ *   double width, double height : Dimensions of the rectangle
+ *   int cols, int rows : Number of cells of the lattice across and down
+ *   sk_point_t *pts : Set to the first max intersections found
+ *   size_t max : Number of points pts has room for
+ *
+ * Returns:
+ *   int : Number of intersections found, which may be more than max
+ *     or SK_ERR_ID, SK_ERR_PARSE, SK_ERR_NOT_CURVE, SK_ERR_ARG, or SK_ERR_NOMEM
+ */
+SK_API int sk_intersect(
+	sk_gallery_t *g, int id1, int id2,
+	double x, double y, double width, double height, int cols, int rows,
+	sk_point_t *pts, size_t max
+);
+
+#endif
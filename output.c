@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+
+#include "output.h"
+
+const char *format_names[FORMAT_COUNT] = {"text", "csv", "jsonl", "binary"};
+
+// Cut the digits of a decimal mantissa down to n digits rounding toward zero, or away from zero if up is set
+// Returns the exponent of the new mantissa which is one more than exp if rounding carried out of the first digit
+static int round_digits(const char *digs, int n, bool up, char *out, int exp){
+	memcpy(out, digs, n);
+	if(!up) return exp;
+	
+	// Propagate the carry up through any nines
+	int i;
+	for(i = n - 1; i >= 0 && out[i] == '9'; i--) out[i] = '0';
+	if(i >= 0){
+		out[i]++;
+		return exp;
+	}
+	
+	// Every digit was a nine so the mantissa became 10.00...
+	out[0] = '1';
+	return exp + 1;
+}
+
+// Check if the n digits with the decimal exponent exp read back as v
+static bool reads_back(bool neg, const char *digs, int n, int exp, double v){
+	char buf[DOUBLE_STR_SIZE], *s = buf;
+	if(neg) *(s++) = '-';
+	*(s++) = digs[0];
+	*(s++) = '.';
+	memcpy(s, digs + 1, n - 1);
+	s += n - 1;
+	sprintf(s, "e%d", exp);
+	
+	return strtod(buf, NULL) == v;
+}
+
+// Powers of ten that fit in 64 bits
+static const uint64_t pow10s[20] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+	1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+	100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+	1000000000000000000ull, 10000000000000000000ull
+};
+
+/* Find the shortest digits of |v| exactly using 128 bit integers
+ * v is scaled by 10^k so that it has 17 digits before the point and the bounds of the interval
+ * of reals that round to v are found exactly, which only fits in 128 bits for moderate magnitudes
+ * The multiple of the largest power of ten inside the interval that is closest to v is chosen
+ * Returns the number of digits written to digs or 0 if v is out of range and *exp is not set
+ */
+static int shortest_digits(double v, char *digs, int *exp){
+	int e2;
+	double f = frexp(fabs(v), &e2);
+	if(f == 0) return 0;
+	
+	// |v| = m * 2^e2 with m a 53 bit integer
+	uint64_t m = (uint64_t)ldexp(f, 53);
+	e2 -= 53;
+	
+	// Scale to about 17 digits before the point and keep the numerator of the bounds within 128 bits
+	int k = 16 - (int)floor(log10(fabs(v)));
+	if(k < 0 || k > 21 || e2 > 8) return 0;
+	
+	// Bounds and v in units of 2^(e2 - 2) times 10^k
+	// The gap below a power of two is half as wide as the one above it
+	unsigned __int128 scale = k < 20 ? pow10s[k] : (unsigned __int128)pow10s[k - 10] * pow10s[10];
+	unsigned __int128 lo = (4 * m - (m == (1ull << 52) && v != DBL_MIN && -v != DBL_MIN ? 1 : 2)) * scale;
+	unsigned __int128 mid = 4 * m * scale, hi = (4 * m + 2) * scale;
+	
+	// Integers strictly inside the bounds, or including them when m is even since ties round to even
+	bool even = !(m & 1);
+	uint64_t a, b, c;
+	// Fractional part of v which is -2 if zero, then -1, 0 or 1 if below, at or above a half
+	int frac = -2;
+	if(e2 - 2 >= 0){
+		lo <<= e2 - 2;
+		mid <<= e2 - 2;
+		hi <<= e2 - 2;
+		a = (uint64_t)lo + !even;
+		b = (uint64_t)hi - !even;
+		c = (uint64_t)mid;
+	}else{
+		int sh = 2 - e2;
+		unsigned __int128 mask = ((unsigned __int128)1 << sh) - 1;
+		a = (uint64_t)(lo >> sh) + ((lo & mask) != 0 || !even);
+		b = (uint64_t)(hi >> sh) - ((hi & mask) == 0 && !even);
+		c = (uint64_t)(mid >> sh);
+		unsigned __int128 rem = mid & mask, half = (unsigned __int128)1 << (sh - 1);
+		frac = rem > half ? 1 : rem == half ? 0 : rem ? -1 : -2;
+	}
+	
+	// Largest power of ten with a multiple between a and b
+	int j = 0;
+	while(j < 19 && (a + pow10s[j + 1] - 1) / pow10s[j + 1] <= b / pow10s[j + 1]) j++;
+	
+	// Multiple closest to v that is still inside
+	// Rounds up when 2 * (c % p + fractional part) > p
+	uint64_t p = pow10s[j], q = c / p, r2 = 2 * (c % p);
+	if(r2 > p || (r2 == p && frac > -2) || (r2 + 1 == p && frac > 0)) q++;
+	if(q * p < a) q++;
+	if(q * p > b) q--;
+	
+	// Write the digits of q dropping trailing zeros
+	char tmp[20];
+	int n = 0;
+	for(; q; q /= 10) tmp[n++] = '0' + q % 10;
+	int zeros = 0;
+	while(zeros < n - 1 && tmp[zeros] == '0') zeros++;
+	for(int i = 0; i < n - zeros; i++) digs[i] = tmp[n - 1 - i];
+	
+	*exp = n - 1 + j - k;
+	return n - zeros;
+}
+
+int format_double(char *buf, double v){
+	// Not the location of any intersection but still written as something readable
+	if(!isfinite(v)) return snprintf(buf, DOUBLE_STR_SIZE, "%g", v);
+	
+	bool neg = signbit(v);
+	char digs[17], *s;
+	int exp, n = shortest_digits(v, digs, &exp);
+	if(n > 0) goto emit;
+	
+	// 17 significant digits always read back as the same double
+	// Split them into the sign, the digits, and the decimal exponent of the first digit
+	char sci[DOUBLE_STR_SIZE];
+	snprintf(sci, sizeof(sci), "%.16e", v);
+	s = sci + neg;
+	int nd = 0;
+	for(; *s != 'e'; s++) if(*s != '.') digs[nd++] = *s;
+	exp = atoi(s + 1);
+	
+	// Fewer digits suffice for most values that were ever written in decimal
+	// Any normal value with at most 15 significant digits is reproduced with 15
+	// Either neighbour of v with n digits may be the one that reads back so both are tried, nearest first
+	char short_digs[17];
+	for(n = fabs(v) < DBL_MIN ? 1 : 15; n < nd; n++){
+		bool up = digs[n] >= '5', found = 0;
+		for(int k = 0; k < 2 && !found; k++, up = !up){
+			int short_exp = round_digits(digs, n, up, short_digs, exp);
+			if(reads_back(neg, short_digs, n, short_exp, v)){
+				memcpy(digs, short_digs, n);
+				exp = short_exp;
+				found = 1;
+			}
+		}
+		if(found) break;
+	}
+	// Drop trailing zeros
+	while(n > 1 && digs[n - 1] == '0') n--;
+	
+emit:
+	s = buf;
+	if(neg) *(s++) = '-';
+	if(exp < -5 || exp >= 17){
+		// Scientific notation for very small or large values
+		*(s++) = digs[0];
+		if(n > 1){
+			*(s++) = '.';
+			memcpy(s, digs + 1, n - 1);
+			s += n - 1;
+		}
+		s += sprintf(s, "e%d", exp);
+	}else if(exp < 0){
+		// Leading zeros after the decimal point
+		*(s++) = '0';
+		*(s++) = '.';
+		for(int i = -1; i > exp; i--) *(s++) = '0';
+		memcpy(s, digs, n);
+		s += n;
+	}else{
+		// Digits before the decimal point padded with zeros if the mantissa is shorter
+		for(int i = 0; i <= exp; i++) *(s++) = i < n ? digs[i] : '0';
+		if(n > exp + 1){
+			*(s++) = '.';
+			memcpy(s, digs + exp + 1, n - exp - 1);
+			s += n - exp - 1;
+		}
+	}
+	*s = '\0';
+	
+	return s - buf;
+}
+
+// Store the n low bytes of v into p from least to most significant
+static void put_le(unsigned char *p, uint64_t v, int n){
+	for(int i = 0; i < n; i++){
+		p[i] = v & 0xff;
+		v >>= 8;
+	}
+}
+
+// Append the decimal digits of v to s and return the end
+static char *put_uint(char *s, unsigned v){
+	char tmp[10];
+	int n = 0;
+	do{
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	}while(v);
+	while(n) *(s++) = tmp[--n];
+	return s;
+}
+
+// Append the string str to s and return the end
+static char *put_str(char *s, const char *str){
+	size_t len = strlen(str);
+	memcpy(s, str, len);
+	return s + len;
+}
+
+void write_inters_header(FILE *fp, format_t fmt){
+	if(fmt == FORMAT_CSV) fputs("pair,curve1,curve2,x,y\n", fp);
+}
+
+void write_inters(FILE *fp, format_t fmt, inter_t inters, unsigned pair, int curve1, int curve2){
+	if(!inters) return;
+	
+	// Room for the fields around two doubles
+	char line[2 * DOUBLE_STR_SIZE + 96], *s;
+	unsigned char rec[OUTPUT_RECORD_SIZE];
+	uint64_t bits;
+	
+	inter_t inr = inters;
+	do{
+		switch(fmt){
+			case FORMAT_CSV:
+			case FORMAT_JSONL:
+			{
+				// The fields are assembled by hand since this is the bulk of the time spent on large outputs
+				bool csv = fmt == FORMAT_CSV;
+				s = put_str(line, csv ? "" : "{\"pair\":");
+				s = put_uint(s, pair);
+				s = put_str(s, csv ? "," : ",\"curve1\":");
+				s = put_uint(s, curve1);
+				s = put_str(s, csv ? "," : ",\"curve2\":");
+				s = put_uint(s, curve2);
+				s = put_str(s, csv ? "," : ",\"x\":");
+				s += format_double(s, inr->x);
+				s = put_str(s, csv ? "," : ",\"y\":");
+				s += format_double(s, inr->y);
+				s = put_str(s, csv ? "\n" : "}\n");
+				fwrite(line, 1, s - line, fp);
+			}
+			break;
+			
+			case FORMAT_BINARY:
+				put_le(rec, pair, 4);
+				memcpy(&bits, &(inr->x), sizeof(bits));
+				put_le(rec + 4, bits, 8);
+				memcpy(&bits, &(inr->y), sizeof(bits));
+				put_le(rec + 12, bits, 8);
+				fwrite(rec, 1, OUTPUT_RECORD_SIZE, fp);
+			break;
+			
+			// Text is written along with the equations by the caller
+			default: return;
+		}
+		
+		inr = inr->next;
+	}while(inr != inters);
+}
+
+void write_gallery_inters(FILE *fp, format_t fmt, equat_t gallery, struct bound_s rect, signgrid_t *grid, int (*curve_id)(equat_t)){
+	// Collect the curves in the order they are numbered along with their labels
+	int count = 0;
+	for(equat_t eq = gallery; eq; eq = eq->next) if(!(eq->is_variable) && eq->right) count++;
+	equat_t *eqs = malloc((count > 0 ? count : 1) * sizeof(equat_t));
+	int *labels = malloc((count > 0 ? count : 1) * sizeof(int));
+	if(!eqs || !labels){
+		free(eqs);
+		free(labels);
+		return;
+	}
+	count = 0;
+	for(equat_t eq = gallery; eq; eq = eq->next) if(!(eq->is_variable) && eq->right){
+		labels[count] = curve_id ? curve_id(eq) : count;
+		eqs[count++] = eq;
+	}
+	
+	// Sample every curve once on the lattice so pairs don't need to reevaluate them
+	// unless grid already holds all of their signs on it
+	bool sampled = 1;
+	for(int i = 0; i < count && sampled; i++) sampled = signgrid_find(grid, rect, eqs[i]) != NULL;
+	if(!sampled) sample_equats(grid, rect, eqs, count);
+	
+	write_inters_header(fp, fmt);
+	
+	// Intersections closer than this are treated as the same one
+	double prec = (rect.width < rect.height ? rect.width : rect.height) / 10000;
+	
+	// Iterate over all pairs of equations
+	inter_t inters = NULL;
+	unsigned pair = 0;
+	bool isfst = 1;
+	for(int i = 0; i < count; i++){
+		equat_t eq1 = eqs[i];
+		// Iterate over all equations after eq1
+		for(int j = i + 1; j < count; j++, pair++){
+			equat_t eq2 = eqs[j];
+			
+			// Find intersections using the sampled signs
+			rect.signs1 = signgrid_find(grid, rect, eq1);
+			rect.signs2 = signgrid_find(grid, rect, eq2);
+			append_inters(&inters, rect, eval_equat, eq1, eval_equat, eq2, 30, prec);
+			
+			// If no intersections found move to next curve pair
+			if(!inters) continue;
+			
+			if(fmt == FORMAT_TEXT){
+				// Print Header for intersections between these curves
+				fprintf(fp, "%s%s  &  %s\n", isfst ? "" : "\n", eq1->text, eq2->text);
+				isfst = 0;
+				
+				inter_t inr = inters;
+				do{
+					// Print each intersection
+					fprintf(fp, "( %.17lf , %.17lf )\n", inr->x, inr->y);
+					
+					inr = inr->next;
+				}while(inr != inters);
+			}else{
+				write_inters(fp, fmt, inters, pair, labels[i], labels[j]);
+			}
+			
+			// Empty out intersection list for next pair
+			free_inters(inters);
+			inters = NULL;
+		}
+	}
+	free(eqs);
+	free(labels);
+}
@@ -0,0 +1,71 @@
+#ifndef _OUTPUT_H
+#define _OUTPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "intersect.h"
+#include "signgrid.h"
+#include "gallery.h"
+
+// Size of the buffer used for stdout when writing intersections
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+// Longest string written by format_double including the null
+#define DOUBLE_STR_SIZE 32
+
+/* Binary intersection records are OUTPUT_RECORD_SIZE bytes with no padding:
+ *   uint32 pair id
+ *   double x
+ *   double y
+ * All stored little-endian with the doubles in IEEE 754 binary64
+ */
+#define OUTPUT_RECORD_SIZE 20
+
+// Formats the intersections can be printed in
+typedef enum{
+	FORMAT_TEXT = 0,  // Header with the text of the equations followed by "( x , y )" lines
+	FORMAT_CSV,  // pair,curve1,curve2,x,y
+	FORMAT_JSONL,  // One JSON object with the same fields per line
+	FORMAT_BINARY,  // Records of OUTPUT_RECORD_SIZE bytes
+	FORMAT_COUNT
+} format_t;
+
+// Names of the formats as given to --format
+extern const char *format_names[FORMAT_COUNT];
+
+// Write the shortest decimal representation of v which reads back as the same double
+// buf must have room for DOUBLE_STR_SIZE characters
+// Returns the number of characters written excluding the null
+int format_double(char *buf, double v);
+
+// Write anything preceding the intersections in fmt (the column names of csv) to fp
+void write_inters_header(FILE *fp, format_t fmt);
+/* Write every intersection in a circular list to fp in a machine-readable format
+ * 
+ * Arguments:
+ *   FILE *fp : Stream to write to
+ *   format_t fmt : FORMAT_CSV, FORMAT_JSONL, or FORMAT_BINARY
+ *   inter_t inters : Circular linked list of intersections
+ *   unsigned pair : Index of the pair of curves in the order pairs are searched
+ *   int curve1, int curve2 : Labels of the curves (see write_gallery_inters)
+ *     Only written by the text formats since the binary records are identified by pair
+ */
+void write_inters(FILE *fp, format_t fmt, inter_t inters, unsigned pair, int curve1, int curve2);
+/* Find the intersections between every pair of curves of gallery within rect and write them to fp
+ * Pairs are numbered in the order they are searched (i < j) including pairs without intersections
+ * 
+ * Arguments:
+ *   FILE *fp : Stream to write to
+ *   format_t fmt : Format to write the intersections in
+ *   equat_t gallery : Equations whose curves are intersected
+ *   struct bound_s rect : Area and lattice to search (its signs are ignored)
+ *   signgrid_t *grid : Signs of the curves that are reused if they were all sampled exactly on the lattice of rect
+ *     Otherwise the curves are sampled into grid
+ *     Must not hold signs of curves that changed after they were sampled
+ *   int (*curve_id)(equat_t) : Gives the label of each curve written with its intersections
+ *     If NULL the curves are labelled by their indices among the proper equations
+ */
+void write_gallery_inters(FILE *fp, format_t fmt, equat_t gallery, struct bound_s rect, signgrid_t *grid, int (*curve_id)(equat_t));
+
+#endif
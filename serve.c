@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "serve.h"
+#include "graph.h"
+#include "output.h"
+#include "compile.h"
+
+// Connection to a client
+struct client_s{
+	int fd;
+	
+	// Bytes received which don't form a whole request yet
+	unsigned char *in;
+	size_t in_len, in_cap;
+	
+	// Replies waiting to be sent starting at out_sent
+	unsigned char *out;
+	size_t out_len, out_sent, out_cap;
+	
+	// Set once the client shut down its side of the connection
+	// The requests already received are still answered before it is closed
+	bool closed;
+};
+
+// Copy of a reply kept in the cache
+struct reply_s{
+	char *data;
+	size_t len;
+};
+
+// Equations being served and the last of them to append after
+static equat_t *gallery, tail;
+// Equation of each id or NULL if it was removed
+static equat_t *ids;
+static size_t ids_count, ids_cap;
+
+// Signs sampled by the last render or search which later searches of the same lattice reuse
+static signgrid_t grid;
+// Replies to render and inters requests by the text of the request
+static symtab_t cache;
+
+// Whether edited equations are compiled to native code again (see compile.h)
+static bool compiling;
+
+// Set by SIGINT or SIGTERM to stop serving
+static volatile sig_atomic_t stopping = 0;
+
+
+
+static void stop_serving(int sig){
+	(void)sig;
+	stopping = 1;
+}
+
+// Forget all signs and replies after the gallery changed
+static void clear_cache(void){
+	for(size_t i = 0; i < cache.nbuckets; i++){
+		for(struct sym_s *sym = cache.buckets[i]; sym; sym = sym->next){
+			struct reply_s *rep = sym->value;
+			free(rep->data);
+			free(rep);
+		}
+	}
+	symtab_free(&cache);
+	signgrid_free(&grid);
+}
+
+// Keep data as the reply to the request body
+// Takes ownership of data which is deallocated if it can't be kept
+static void cache_reply(const char *body, size_t len, char *data, size_t data_len){
+	if(cache.count >= SERVE_CACHE_SIZE) clear_cache();
+	
+	struct reply_s *rep = malloc(sizeof(struct reply_s));
+	if(rep){
+		rep->data = data;
+		rep->len = data_len;
+		if(symtab_add(&cache, body, len, rep)) return;
+		free(rep);
+	}
+	free(data);
+}
+
+// Give eq the next id
+static bool add_id(equat_t eq){
+	if(ids_count == ids_cap){
+		size_t cap = ids_cap ? 2 * ids_cap : 64;
+		equat_t *grown = realloc(ids, cap * sizeof(equat_t));
+		if(!grown) return 0;
+		ids = grown;
+		ids_cap = cap;
+	}
+	ids[ids_count++] = eq;
+	return 1;
+}
+
+// Find the equation whose id is the number at the start of str
+// Sets *end to the character after the id
+static equat_t find_id(const char *str, char **end){
+	errno = 0;
+	unsigned long id = strtoul(str, end, 10);
+	if(*end == str || errno || id >= ids_count) return NULL;
+	return ids[id];
+}
+
+// Id of eq which add replied with (or its position among the initial equations)
+static int serve_id(equat_t eq){
+	for(size_t id = 0; id < ids_count; id++) if(ids[id] == eq) return (int)id;
+	return -1;
+}
+
+// Put the color pair of each cell a curve is drawn in into the buffer of cells
+static void cells_put(target_t *tg, int x, int y, int ch, int color){
+	(void)ch;
+	if(x < 0 || x >= tg->cols || y < 0 || y >= tg->rows) return;
+	((unsigned char*)tg->data)[(size_t)y * tg->cols + x] = color & ~INVERT_PAIR;
+}
+
+
+
+// Write SERVE_ERR and the message to fp
+static void reply_err(FILE *fp, const char *msg){
+	fputc(SERVE_ERR, fp);
+	fputs(msg, fp);
+}
+
+// Reply with the error of the equation eq
+static void reply_parse_err(FILE *fp, equat_t eq){
+	fputc(SERVE_ERR, fp);
+	fprintf(fp, "Error %s while reading equation: %s", parse_errstr[eq->err], equat_text(eq));
+}
+
+/* Carry out a request and write the reply to fp
+ *
+ * Arguments:
+ *   char *body : Null terminated body of the request
+ *   FILE *fp : Stream to write the body of the reply to
+ *
+ * Returns:
+ *   bool : Whether the gallery was changed
+ */
+static bool run_request(char *body, FILE *fp){
+	// Split the command from its arguments
+	char *arg = strchr(body, ' ');
+	if(arg) *(arg++) = '\0';
+	else arg = body + strlen(body);
+	
+	char *end;
+	equat_t eq;
+	if(strcmp(body, "add") == 0){
+		eq = append_equat(gallery, tail, arg);
+		if(!eq || !add_id(eq)){
+			if(eq) remove_equat(gallery, eq);
+			reply_err(fp, "Unable to allocate equation");
+			return 0;
+		}
+		
+		if(parse_equat(*gallery, eq) != ERR_OK){
+			reply_parse_err(fp, eq);
+			ids_count--;
+			remove_equat(gallery, eq);
+			return 0;
+		}
+		tail = eq;
+		
+		fprintf(fp, "%c%zu", SERVE_OK, ids_count - 1);
+		return 1;
+	}else if(strcmp(body, "set") == 0){
+		if(!(eq = find_id(arg, &end)) || *end != ' '){
+			reply_err(fp, "Unknown equation");
+			return 0;
+		}
+		
+		// Keep the old text to restore if the new one can't be parsed
+		char *old = strdup(equat_text(eq));
+		if(!old || !set_equat_text(eq, end + 1)){
+			free(old);
+			reply_err(fp, "Unable to allocate equation");
+			return 0;
+		}
+		
+		if(parse_equat(*gallery, eq) != ERR_OK){
+			reply_parse_err(fp, eq);
+			set_equat_text(eq, old);
+			parse_equat(*gallery, eq);
+		}else{
+			fputc(SERVE_OK, fp);
+		}
+		free(old);
+		return 1;
+	}else if(strcmp(body, "remove") == 0){
+		if(!(eq = find_id(arg, &end)) || *end){
+			reply_err(fp, "Unknown equation");
+			return 0;
+		}
+		
+		ids[strtoul(arg, NULL, 10)] = NULL;
+		if(tail == eq) tail = eq->prev;
+		remove_equat(gallery, eq);
+		
+		fputc(SERVE_OK, fp);
+		return 1;
+	}else if(strcmp(body, "list") == 0){
+		fputc(SERVE_OK, fp);
+		for(size_t id = 0; id < ids_count; id++){
+			if(ids[id]) fprintf(fp, "%zu %s\n", id, equat_text(ids[id]));
+		}
+		return 0;
+	}
+	
+	// Both queries describe a region and the lattice of cells in it
+	double x, y, wid, hei;
+	int cols, rows, n;
+	char fmtname[16];
+	bool isrender = strcmp(body, "render") == 0;
+	if(!isrender && strcmp(body, "inters") != 0){
+		reply_err(fp, "Unknown command");
+		return 0;
+	}
+	n = sscanf(arg, "%lf %lf %lf %lf %d %d %15s", &x, &y, &wid, &hei, &cols, &rows, fmtname);
+	if(n < 6 || (isrender && n > 6)
+	|| !(wid > 0) || !(hei > 0) || cols <= 0 || rows <= 0 || (size_t)cols * rows > SERVE_MAX_CELLS
+	){
+		reply_err(fp, "Invalid region");
+		return 0;
+	}
+	
+	if(isrender){
+		unsigned char *cells = calloc((size_t)cols * rows, 1);
+		if(!cells){
+			reply_err(fp, "Unable to allocate cells");
+			return 0;
+		}
+		
+		// Implicit curves leave their signs in grid for a search of the same lattice
+		target_t tg = {cols, rows, cells_put, NULL, cells};
+		graph_t gr = {&tg, x, y, wid, hei};
+		draw_curves(gr, *gallery, RENDER_SCAN, &grid);
+		
+		fputc(SERVE_OK, fp);
+		fwrite(cells, 1, (size_t)cols * rows, fp);
+		free(cells);
+	}else{
+		format_t fmt = FORMAT_BINARY;
+		if(n == 7){
+			for(fmt = 0; fmt < FORMAT_COUNT && strcmp(fmtname, format_names[fmt]) != 0; fmt++){}
+			if(fmt == FORMAT_COUNT){
+				reply_err(fp, "Unknown format");
+				return 0;
+			}
+		}
+		
+		struct bound_s rect = {.x = x, .y = y, .width = wid, .height = hei, .rows = rows, .columns = cols};
+		fputc(SERVE_OK, fp);
+		// Curves are labelled by their ids so the labels stay valid after removals
+		write_gallery_inters(fp, fmt, *gallery, rect, &grid, serve_id);
+	}
+	return 0;
+}
+
+
+
+// Add a frame holding the reply data to the replies waiting to be sent to cl
+static bool queue_reply(struct client_s *cl, const char *data, size_t len){
+	size_t need = cl->out_len + SERVE_HEADER_SIZE + len;
+	if(need > cl->out_cap){
+		size_t cap = 2 * cl->out_cap > need ? 2 * cl->out_cap : need;
+		unsigned char *out = realloc(cl->out, cap);
+		if(!out) return 0;
+		cl->out = out;
+		cl->out_cap = cap;
+	}
+	
+	serve_put_len(cl->out + cl->out_len, len);
+	memcpy(cl->out + cl->out_len + SERVE_HEADER_SIZE, data, len);
+	cl->out_len = need;
+	return 1;
+}
+
+// Answer the request of len bytes at req from the cache or by carrying it out
+static bool respond(struct client_s *cl, const char *req, size_t len){
+	// Queries are answered the same way until the gallery changes
+	bool cacheable = len > 7 && (memcmp(req, "render ", 7) == 0 || memcmp(req, "inters ", 7) == 0);
+	struct sym_s *hit = cacheable ? symtab_find(&cache, req, len) : NULL;
+	if(hit){
+		struct reply_s *rep = hit->value;
+		return queue_reply(cl, rep->data, rep->len);
+	}
+	
+	char *body = malloc(len + 1), *data = NULL;
+	size_t data_len = 0;
+	FILE *fp = open_memstream(&data, &data_len);
+	if(!body || !fp){
+		free(body);
+		if(fp) fclose(fp);
+		free(data);
+		return 0;
+	}
+	memcpy(body, req, len);
+	body[len] = '\0';
+	
+	bool changed = run_request(body, fp);
+	fclose(fp);
+	free(body);
+	if(changed) clear_cache();
+	// Reparsing drops the native code of the equation and those using it
+	if(changed && compiling) compile_equats(*gallery);
+	
+	bool queued = queue_reply(cl, data, data_len);
+	if(cacheable && data_len > 0 && data[0] == SERVE_OK) cache_reply(req, len, data, data_len);
+	else free(data);
+	return queued;
+}
+
+// Send as much of the replies waiting for cl as the socket takes
+// Returns false if the connection failed
+static bool flush_client(struct client_s *cl){
+	while(cl->out_sent < cl->out_len){
+		ssize_t n = send(cl->fd, cl->out + cl->out_sent, cl->out_len - cl->out_sent, MSG_NOSIGNAL);
+		if(n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		cl->out_sent += n;
+	}
+	cl->out_len = cl->out_sent = 0;
+	return 1;
+}
+
+// Answer the whole requests received from cl
+// The next request is only answered once the client has taken every reply so it can't pile them up
+// Returns false if the client broke the protocol or the connection failed
+static bool handle_client(struct client_s *cl){
+	size_t off = 0;
+	bool ok = flush_client(cl);
+	while(ok && cl->out_len == 0 && cl->in_len - off >= SERVE_HEADER_SIZE){
+		uint32_t len = serve_get_len(cl->in + off);
+		if(len > SERVE_MAX_REQUEST) ok = 0;
+		if(!ok || cl->in_len - off - SERVE_HEADER_SIZE < len) break;
+		
+		ok = respond(cl, (char*)cl->in + off + SERVE_HEADER_SIZE, len) && flush_client(cl);
+		off += SERVE_HEADER_SIZE + len;
+	}
+	memmove(cl->in, cl->in + off, cl->in_len - off);
+	cl->in_len -= off;
+	return ok;
+}
+
+// Read from cl and answer the requests received
+// Returns false if the connection failed or the client broke the protocol
+static bool read_client(struct client_s *cl){
+	if(cl->in_cap - cl->in_len < 4096){
+		size_t cap = cl->in_cap ? 2 * cl->in_cap : 65536;
+		unsigned char *in = realloc(cl->in, cap);
+		if(!in) return 0;
+		cl->in = in;
+		cl->in_cap = cap;
+	}
+	
+	ssize_t n = recv(cl->fd, cl->in + cl->in_len, cl->in_cap - cl->in_len, 0);
+	if(n == 0){
+		cl->closed = 1;
+		return handle_client(cl);
+	}
+	if(n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	cl->in_len += n;
+	
+	return handle_client(cl);
+}
+
+static void close_client(struct client_s *cl){
+	close(cl->fd);
+	free(cl->in);
+	free(cl->out);
+}
+
+// Create a socket listening at path
+// A socket left at path by a server that is no longer running is replaced
+// Returns the socket or -1 if it couldn't be created
+static int listen_at(const char *path){
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0) return -1;
+	
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+		// Only remove the file if nothing is accepting connections on it
+		int probe = errno == EADDRINUSE ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+		bool stale = probe >= 0 && connect(probe, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno == ECONNREFUSED;
+		if(probe >= 0) close(probe);
+		
+		if(!stale || unlink(path) < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+			if(stale) errno = EADDRINUSE;
+			close(fd);
+			return -1;
+		}
+	}
+	
+	if(listen(fd, SERVE_MAX_CLIENTS) < 0){
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+	return fd;
+}
+
+bool serve(const char *path, equat_t *gal, bool compile){
+	int lfd = listen_at(path);
+	if(lfd < 0) return 0;
+	
+	// Interrupt poll instead of restarting it so the socket can be removed on exit
+	struct sigaction sa = {0};
+	sa.sa_handler = stop_serving;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	
+	gallery = gal;
+	compiling = compile;
+	tail = NULL;
+	for(equat_t eq = *gallery; eq; eq = eq->next){
+		add_id(eq);
+		tail = eq;
+	}
+	
+	struct client_s clients[SERVE_MAX_CLIENTS];
+	struct pollfd fds[SERVE_MAX_CLIENTS + 1];
+	int nclients = 0;
+	while(!stopping){
+		// Stop accepting clients when full and reading from those whose replies haven't all been taken
+		fds[0] = (struct pollfd){lfd, nclients < SERVE_MAX_CLIENTS ? POLLIN : 0, 0};
+		for(int i = 0; i < nclients; i++){
+			fds[i + 1] = (struct pollfd){clients[i].fd, clients[i].out_sent < clients[i].out_len ? POLLOUT : POLLIN, 0};
+		}
+		
+		if(poll(fds, nclients + 1, -1) < 0){
+			if(errno == EINTR) continue;
+			break;
+		}
+		
+		// Clients are visited from the last so one can be replaced by the last when it disconnects
+		for(int i = nclients - 1; i >= 0; i--){
+			short rev = fds[i + 1].revents;
+			if(!rev) continue;
+			
+			bool ok;
+			if(rev & POLLOUT) ok = handle_client(&clients[i]);
+			else if(rev & POLLIN) ok = read_client(&clients[i]);
+			else ok = 0;  // Hung up or failed
+			
+			// Clients which shut down are closed once every reply to their requests is sent
+			if(!ok || (clients[i].closed && clients[i].out_len == 0)){
+				close_client(&clients[i]);
+				clients[i] = clients[--nclients];
+			}
+		}
+		
+		if(fds[0].revents & POLLIN){
+			int fd = accept(lfd, NULL, NULL);
+			if(fd >= 0){
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				clients[nclients++] = (struct client_s){fd, NULL, 0, 0, NULL, 0, 0, 0, 0};
+			}
+		}
+	}
+	
+	for(int i = 0; i < nclients; i++) close_client(&clients[i]);
+	close(lfd);
+	unlink(path);
+	
+	clear_cache();
+	free(ids);
+	ids = NULL;
+	ids_count = ids_cap = 0;
+	return 1;
+}
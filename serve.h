@@ -0,0 +1,65 @@
+#ifndef _SERVE_H
+#define _SERVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gallery.h"
+
+/* Protocol spoken over the Unix socket of the server
+ *
+ * Every message in either direction is a frame of a 32 bit little-endian length
+ * followed by that many bytes of body
+ *
+ * The body of a request is a command followed by its arguments separated by spaces:
+ *   add EQUATION : Add an equation to the end of the gallery, replies with its id
+ *   set ID EQUATION : Replace the text of an equation and reparse it (and those using it)
+ *   remove ID : Remove an equation from the gallery
+ *   list : Replies with a line of "ID TEXT" for each equation
+ *   render X Y WIDTH HEIGHT COLS ROWS : Draw the curves in the region of the plane with the
+ *     upper left corner (X, Y) onto COLS by ROWS cells, replies with a byte for each cell row by row
+ *     which holds the color pair of the curve drawn there or 0 if there is none
+ *   inters X Y WIDTH HEIGHT COLS ROWS [FORMAT] : Find the intersections of every pair of curves in the
+ *     region searching a lattice of COLS by ROWS cells, replies with the intersections written in FORMAT
+ *     (see output.h) which defaults to binary, with the curves labelled by their ids
+ *
+ * The body of a reply starts with SERVE_OK followed by its data
+ * or SERVE_ERR followed by a message describing the error
+ *
+ * Replies to render and inters are cached until the gallery changes so repeated queries are only copied
+ */
+#define SERVE_OK '+'
+#define SERVE_ERR '-'
+
+// Bytes in the length prefixing each frame
+#define SERVE_HEADER_SIZE 4
+// Largest body of a request that is accepted, larger ones disconnect the client
+#define SERVE_MAX_REQUEST (1 << 20)
+// Largest number of cells rendered for one request
+#define SERVE_MAX_CELLS (1 << 24)
+// Most clients connected at once, more wait to be accepted
+#define SERVE_MAX_CLIENTS 64
+// Most replies kept in the cache before it is emptied
+#define SERVE_CACHE_SIZE 256
+
+// Read and write the length prefixing a frame at p
+#define serve_get_len(p) ((uint32_t)(p)[0] | (uint32_t)(p)[1] << 8 | (uint32_t)(p)[2] << 16 | (uint32_t)(p)[3] << 24)
+#define serve_put_len(p, len) ((p)[0] = (len) & 0xff, (p)[1] = (len) >> 8 & 0xff, (p)[2] = (len) >> 16 & 0xff, (p)[3] = (len) >> 24 & 0xff)
+
+/* Serve requests on a Unix socket at path until interrupted (SIGINT or SIGTERM)
+ * Clients are handled concurrently by one thread which waits on all of their sockets with poll
+ * Each request is answered in full before the next is read so they never interleave
+ *
+ * Arguments:
+ *   const char *path : Path of the socket which is created and removed afterwards
+ *   equat_t *gallery : Equations to serve which are modified by requests
+ *     The equations already in it are given the ids 0, 1, 2, ... in order
+ *   bool compile : Whether equations are compiled again after requests change them (see compile.h)
+ *
+ * Returns:
+ *   bool : Whether the socket could be created
+ */
+bool serve(const char *path, equat_t *gallery, bool compile);
+
+#endif
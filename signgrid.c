@@ -0,0 +1,84 @@
+#include <stdlib.h>
+
+#include "signgrid.h"
+
+bool signgrid_reset(signgrid_t *sg, struct bound_s rect, int count){
+	sg->rect = rect;
+	sg->count = 0;
+	sg->approximate = 0;
+	
+	if(count > sg->inputs_cap){
+		void **inputs = realloc(sg->inputs, count * sizeof(void*));
+		if(!inputs) return 0;
+		sg->inputs = inputs;
+		sg->inputs_cap = count;
+	}
+	
+	size_t size = signgrid_size(sg) * count;
+	if(size > sg->signs_cap){
+		uint64_t *signs = realloc(sg->signs, size * sizeof(uint64_t));
+		if(!signs) return 0;
+		sg->signs = signs;
+		sg->signs_cap = size;
+	}
+	
+	sg->count = count;
+	return 1;
+}
+
+void signgrid_free(signgrid_t *sg){
+	free(sg->inputs);
+	free(sg->signs);
+	sg->inputs = NULL;
+	sg->signs = NULL;
+	sg->inputs_cap = 0;
+	sg->signs_cap = 0;
+	sg->count = 0;
+}
+
+
+
+size_t signgrid_stride(const signgrid_t *sg){
+	return signrow_words(sg->rect.columns + 1);
+}
+
+size_t signgrid_size(const signgrid_t *sg){
+	return (size_t)(sg->rect.rows + 1) * signgrid_stride(sg);
+}
+
+uint64_t *signgrid_plane(const signgrid_t *sg, int k){
+	return sg->signs + k * signgrid_size(sg);
+}
+
+const uint64_t *signgrid_find(const signgrid_t *sg, struct bound_s rect, void *inp){
+	// Lattice must match exactly for the signs to be valid
+	if(sg->approximate
+	|| sg->rect.x != rect.x || sg->rect.y != rect.y
+	|| sg->rect.width != rect.width || sg->rect.height != rect.height
+	|| sg->rect.rows != rect.rows || sg->rect.columns != rect.columns
+	) return NULL;
+	
+	for(int k = 0; k < sg->count; k++){
+		if(sg->inputs[k] == inp) return signgrid_plane(sg, k);
+	}
+	return NULL;
+}
+
+
+
+uint64_t signrow_cells(const uint64_t *upper, const uint64_t *lower, int cells, size_t w, uint64_t corners[4]){
+	// The right corners are the next point over so shift in the first point of the next word
+	bool last = (w + 1) * SIGNROW_BITS > (size_t)cells;
+	corners[0] = upper[w];
+	corners[1] = upper[w] >> 1 | (last ? 0 : upper[w + 1] << (SIGNROW_BITS - 1));
+	corners[2] = lower[w];
+	corners[3] = lower[w] >> 1 | (last ? 0 : lower[w + 1] << (SIGNROW_BITS - 1));
+	
+	uint64_t mixed = (corners[0] ^ corners[1]) | (corners[0] ^ corners[2]) | (corners[0] ^ corners[3]);
+	
+	// Ignore the bits past the end of the row
+	int rem = cells - (int)(w * SIGNROW_BITS);
+	if(rem < SIGNROW_BITS) mixed &= ((uint64_t)1 << rem) - 1;
+	
+	return mixed;
+}
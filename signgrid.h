@@ -0,0 +1,85 @@
+#ifndef _SIGNGRID_H
+#define _SIGNGRID_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "intersect.h"
+
+/* Rows of signs are packed one bit per point into 64 bit words
+ * Point i of a row is bit i % 64 of word i / 64 and each row starts on a new word
+ * so neighbouring points in a row can be compared a whole word at a time
+ */
+#define SIGNROW_BITS 64
+// Number of words in a row of n points
+#define signrow_words(n) (((size_t)(n) + SIGNROW_BITS - 1) / SIGNROW_BITS)
+// Get the sign of point i in row
+#define signrow_get(row, i) ((int)((row)[(i) / SIGNROW_BITS] >> ((i) % SIGNROW_BITS)) & 0x1)
+// Set the sign of point i in row to v
+#define signrow_put(row, i, v) ((row)[(i) / SIGNROW_BITS] = \
+	((row)[(i) / SIGNROW_BITS] & ~((uint64_t)1 << ((i) % SIGNROW_BITS))) | (uint64_t)((v) & 0x1) << ((i) % SIGNROW_BITS))
+
+/* Classify a word of the cells lying between two rows of signs
+ * Cell i has the corners i and i + 1 from upper and lower and is bit i % 64 in word w = i / 64
+ * 
+ * Arguments:
+ *   const uint64_t *upper : Signs of the row of points above the cells
+ *   const uint64_t *lower : Signs of the row of points below the cells
+ *   int cells : Number of cells in the row (the rows contain cells + 1 points)
+ *   size_t w : Index of the word of cells to classify
+ *   uint64_t corners[4] : Set to the signs of the upper left, upper right, lower left and lower right corners of each cell
+ * 
+ * Returns:
+ *   uint64_t : Cells whose corners don't all have the same sign (i.e. those a curve passes through)
+ */
+uint64_t signrow_cells(const uint64_t *upper, const uint64_t *lower, int cells, size_t w, uint64_t corners[4]);
+// Pattern of the corners of cell b within the word classified by signrow_cells
+// Upper left is bit 0, upper right bit 1, lower left bit 2 and lower right bit 3
+#define signrow_pattern(corners, b) ((int)( \
+	((corners)[0] >> (b) & 1) | ((corners)[1] >> (b) & 1) << 1 | \
+	((corners)[2] >> (b) & 1) << 2 | ((corners)[3] >> (b) & 1) << 3))
+
+/* Signs of several functions sampled together on the same lattice
+ * The sign of f at a point is stored as f(x, y) <= 0 (the same test used by curve_inters)
+ * so planes can be passed directly to the intersection search through struct bound_s
+ */
+typedef struct{
+	// Lattice that the functions were sampled on
+	// Contains rect.rows + 1 rows each with rect.columns + 1 points
+	struct bound_s rect;
+	
+	// Number of functions sampled
+	int count;
+	// Parameters passed to each function (used to identify the planes)
+	void **inputs;
+	// Set when the functions were approximated while sampling (e.g. for drawing)
+	// The signs may then differ from exact ones near the curves so they aren't reused to search for intersections
+	bool approximate;
+	
+	// Plane of signs for each function stored row by row as packed rows of words
+	uint64_t *signs;
+	
+	// Amount of memory allocated for inputs and signs
+	int inputs_cap;
+	size_t signs_cap;
+} signgrid_t;
+
+// Prepare sg to store count planes sampled on the lattice of rect, reusing its memory when possible
+// The planes are taken to be exact until approximate is set
+// Returns false if the memory could not be allocated
+bool signgrid_reset(signgrid_t *sg, struct bound_s rect, int count);
+// Deallocate memory used by sg
+void signgrid_free(signgrid_t *sg);
+
+// Number of words in each row of sg
+size_t signgrid_stride(const signgrid_t *sg);
+// Number of words in each plane of sg
+size_t signgrid_size(const signgrid_t *sg);
+// Plane of signs for the k'th function
+uint64_t *signgrid_plane(const signgrid_t *sg, int k);
+// Find the plane for the function given inp that was sampled exactly on the lattice of rect
+// Returns NULL if no such plane exists or the planes of sg are approximate
+const uint64_t *signgrid_find(const signgrid_t *sg, struct bound_s rect, void *inp);
+
+#endif
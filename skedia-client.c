@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "serve.h"
+
+// Client for testing a server started with skedia --serve
+// Sends one request built from the arguments or one request for each line of stdin
+
+const char usage_msg[] =
+	"Usage: skedia-client SOCKET [COMMAND [ARGUMENTS ...]]\n"
+	"Send COMMAND and its arguments to the skedia server listening at SOCKET\n"
+	"and write the reply to stdout. Without a command each line of stdin is sent\n"
+	"as a request. Exits with 1 if any request fails.\n"
+;
+
+// Write or read all len bytes of buf
+static bool send_all(int fd, const void *buf, size_t len){
+	for(const char *p = buf; len > 0;){
+		ssize_t n = write(fd, p, len);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return 0;
+		p += n;
+		len -= n;
+	}
+	return 1;
+}
+static bool recv_all(int fd, void *buf, size_t len){
+	for(char *p = buf; len > 0;){
+		ssize_t n = read(fd, p, len);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return 0;
+		p += n;
+		len -= n;
+	}
+	return 1;
+}
+
+// Send the request of len bytes and write its reply to stdout or its error to stderr
+// Returns 0 if the request succeeded, 1 if it failed, and -1 if the connection was lost
+static int request(int fd, const char *req, size_t len){
+	unsigned char head[SERVE_HEADER_SIZE];
+	serve_put_len(head, len);
+	if(!send_all(fd, head, SERVE_HEADER_SIZE) || !send_all(fd, req, len)) return -1;
+	
+	if(!recv_all(fd, head, SERVE_HEADER_SIZE)) return -1;
+	size_t rlen = serve_get_len(head);
+	char *reply = malloc(rlen > 0 ? rlen : 1);
+	if(!reply || !recv_all(fd, reply, rlen) || rlen == 0){
+		free(reply);
+		return -1;
+	}
+	
+	int status = 0;
+	if(reply[0] == SERVE_OK){
+		fwrite(reply + 1, 1, rlen - 1, stdout);
+	}else{
+		fprintf(stderr, "%.*s\n", (int)(rlen - 1), reply + 1);
+		status = 1;
+	}
+	free(reply);
+	return status;
+}
+
+int main(int argc, char *argv[]){
+	if(argc < 2 || strcmp(argv[1], "-?") == 0 || strcmp(argv[1], "--help") == 0){
+		printf("%s", usage_msg);
+		return argc < 2;
+	}
+	
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+	if(strlen(argv[1]) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "Socket path too long: %s\n", argv[1]);
+		return 1;
+	}
+	strcpy(addr.sun_path, argv[1]);
+	
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+		fprintf(stderr, "Unable to connect to %s: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+	
+	int status = 0, res = 0;
+	if(argc > 2){
+		// Join the arguments with spaces into a single request
+		size_t len = 0;
+		for(int i = 2; i < argc; i++) len += strlen(argv[i]) + 1;
+		char *req = malloc(len), *s = req;
+		if(!req) return 1;
+		for(int i = 2; i < argc; i++){
+			size_t n = strlen(argv[i]);
+			memcpy(s, argv[i], n);
+			s += n;
+			*(s++) = ' ';
+		}
+		
+		res = request(fd, req, len - 1);
+		status = res != 0;
+		free(req);
+	}else{
+		char *line = NULL;
+		size_t cap = 0;
+		ssize_t len;
+		while((len = getline(&line, &cap, stdin)) != -1){
+			while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+			if(len == 0) continue;
+			
+			if((res = request(fd, line, len)) != 0) status = 1;
+			if(res < 0) break;
+		}
+		free(line);
+	}
+	
+	if(res < 0) fprintf(stderr, "Connection to %s lost\n", argv[1]);
+	close(fd);
+	return status;
+}
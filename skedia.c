@@ -4,13 +4,23 @@
 #include <string.h>
 #include <math.h>
 #include <ctype.h> // For int isprint(int c)
+#include <locale.h>
+#include <errno.h>
 
+#define NCURSES_WIDECHAR 1  // Must match term.h
 #include <ncurses.h>
 
 #include "graph.h"
+#include "term.h"
 #include "gallery.h"
 #include "intersect.h"
+#include "image.h"
+#include "output.h"
+#include "serve.h"
 #include "expr.h"
+#include "stats.h"
+#include "trace.h"
+#include "compile.h"
 
 #include "args.h"
 
@@ -32,53 +42,110 @@ inter_t intersections = NULL;
 
 // Store location and size of graph in terminal and in the plane
 graph_t grp = {NULL, -5, 5, 10, 10};
+// Window, frame, and target used to display the graph
+WINDOW *graphwin;
+frame_t graphfr = {0};
+target_t graphtg;
+// Method used to draw implicit curves
+render_t renderer = RENDER_SCAN;
+// Signs of the curves sampled during the last redraw of the graph
+signgrid_t grid = {0};
+
+
+
+// Apply movement or zoom of the viewport associated with key c to gr
+// Returns whether c is one of the movement or zoom keys
+static bool view_key(graph_t *gr, int c){
+	switch(c){
+		// Movement controls
+		case 'j':
+		case KEY_DOWN: gr->y -= gr->hei / 10;
+		break;
+		case 'k':
+		case KEY_UP: gr->y += gr->hei / 10;
+		break;
+		case 'h':
+		case KEY_LEFT: gr->x -= gr->wid / 10;
+		break;
+		case 'l':
+		case KEY_RIGHT: gr->x += gr->wid / 10;
+		break;
+		
+		// Dilation controls in each dimension
+		case 'J':
+		case KEY_SDOWN: zoom_graph(gr, 1, 1.1);
+		break;
+		case 'K':
+		case KEY_SUP: zoom_graph(gr, 1, 0.9);
+		break;
+		case 'H':
+		case KEY_SLEFT: zoom_graph(gr, 1.1, 1);
+		break;
+		case 'L':
+		case KEY_SRIGHT: zoom_graph(gr, 0.9, 1);
+		break;
+		
+		// Dilation controls for both dimensions
+		case '-': zoom_graph(gr, 1.1, 1.1); // Zoom Out (-)
+		break;
+		case '=': zoom_graph(gr, 0.9, 0.9); // Zoom In (+)
+		break;
+		case '0': setdims_graph(gr, 10, 10); // Zoom Standard
+		break;
+		
+		default: return 0;
+	}
+	return 1;
+}
 
 
 
 int main(int argc, char *argv[]){
-	struct args_s args = {0, &grp, &gallery};
+	struct args_s args = {0, FORMAT_TEXT, &grp, &gallery, NULL, 1000, 1000, NULL, 0, 0};
 	parse_args(&args, argc, argv);
+	stats_enabled = args.show_stats;
+	if(args.compile) compile_equats(gallery);
+	
+	
+	// Headless Rendering
+	// ---------------------
+	// Check for '--render' flag to draw graph to an image without ncurses
+	if(args.render_path){
+		if(!render_image(args.render_path, grp, args.render_wid, args.render_hei, gallery, renderer)){
+			fprintf(stderr, "Unable to write image to %s\n", args.render_path);
+			return 1;
+		}
+		if(!args.only_intersects){
+			if(args.show_stats) stats_report(stderr, gallery);
+			return 0;
+		}
+	}
+	
+	
+	// Daemon Mode
+	// ---------------------
+	// Keep the equations and caches in memory to answer queries from other programs
+	if(args.serve_path){
+		if(!serve(args.serve_path, &gallery, args.compile)){
+			fprintf(stderr, "Unable to serve on %s: %s\n", args.serve_path, strerror(errno));
+			return 1;
+		}
+		if(args.show_stats) stats_report(stderr, gallery);
+		return 0;
+	}
 	
 	
 	// Intersection Calculation
 	// ---------------------
 	// Check for '-x' flag to not start ncurses
 	if(args.only_intersects){
-		struct bound_s rect = {grp.x, grp.y, grp.wid, grp.hei, 1000, 1000};
-		bool isfst = 1;
+		struct bound_s rect = {.x = grp.x, .y = grp.y, .width = grp.wid, .height = grp.hei, .rows = 1000, .columns = 1000};
 		
-		// Iterate over all pairs of equations
-		for(equat_t eq1 = gallery; eq1; eq1 = eq1->next) if(!(eq1->is_variable) && eq1->right){
-			// Iterate over all equations after eq1
-			for(equat_t eq2 = eq1->next; eq2; eq2 = eq2->next) if(!(eq2->is_variable) && eq2->right){
-				// Find intersections and store them in intersections
-				append_inters(
-					&intersections, rect,
-					eval_equat, eq1,
-					eval_equat, eq2,
-					30, (grp.wid < grp.hei ? grp.wid : grp.hei) / 10000
-				);
-				
-				// If no intersections found move to next curve pair
-				if(!intersections) continue;
-				
-				// Print Header for intersections between these curves
-				printf("%s%s  &  %s\n", isfst ? "" : "\n", eq1->text, eq2->text);
-				isfst = 0;
-				
-				inter_t inr = intersections;
-				do{
-					// Print each intersection
-					printf("( %.17lf , %.17lf )\n", inr->x, inr->y);
-					
-					inr = inr->next;
-				}while(inr != intersections);
-				
-				// Empty out intersection list for next pair
-				free_inters(intersections);
-				intersections = NULL;
-			}
-		}
+		// Large writes to stdout instead of one per line
+		setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+		write_gallery_inters(stdout, args.format, gallery, rect, &grid, NULL);
+		fflush(stdout);
+		if(args.show_stats) stats_report(stderr, gallery);
 		return 1;
 	}
 	
@@ -89,7 +156,8 @@ int main(int argc, char *argv[]){
 	gtop = gallery;
 	gcurs_idx = 0;  // gcurs starts at same position as gtop
 	
-	// Initialize Ncurses
+	// Initialize Ncurses using the locale's encoding so Braille characters can be drawn
+	setlocale(LC_ALL, "");
 	initscr();
 	raw();
 	keypad(stdscr, TRUE);
@@ -115,13 +183,18 @@ int main(int argc, char *argv[]){
 	init_pair(6 | INVERT_PAIR, COLOR_BLACK, COLOR_MAGENTA);
 	
 	// Use part of screen for graph and part for gallery
-	grp.win = newwin(0, 0, 0, GALLERY_WIDTH + 1);
+	graphwin = newwin(0, 0, 0, GALLERY_WIDTH + 1);
+	frame_target(&graphtg, &graphfr, graphwin);
+	grp.tg = &graphtg;
 	WINDOW *galwin = newwin(0, GALLERY_WIDTH, 0, 0);
+	frame_t galfr = {0};
+	target_t galtg;
+	frame_target(&galtg, &galfr, galwin);
+	
 	
-
 	// Main Loop
 	// ---------------------
-	int c;
+	int c, c2;
 	bool running = 1;
 	// Determine whether the gallery and graph should be redrawn
 	bool update_gallery = 1, update_graph = 1;
@@ -134,22 +207,30 @@ int main(int argc, char *argv[]){
 	
 	// Indicate whether key strokes are sent to the graph or the gallery
 	bool focus_on_graph = 1;
+	// Whether the statistics of each redraw are shown on the top line of the graph
+	// and the counters when the line was last shown
+	bool show_status = 0;
+	stats_t status_stats = stats;
 	while(running){
-		// Check if terminal dimensions to resize `galwin` and `grp.win` appropriately
+		// Check if terminal dimensions to resize `galwin` and `graphwin` appropriately
 		getmaxyx(stdscr, new_scrhei, new_scrwid);
 		if(new_scrhei != scrhei || new_scrwid != scrwid){
 			scrhei = new_scrhei;
 			scrwid = new_scrwid;
 			
-			wresize(grp.win, scrhei, scrwid - GALLERY_WIDTH);
+			wresize(graphwin, scrhei, scrwid - GALLERY_WIDTH);
+			frame_target(&graphtg, &graphfr, graphwin);
 			wresize(galwin, scrhei, GALLERY_WIDTH);
+			frame_target(&galtg, &galfr, galwin);
+			// Stage the resized stdscr beneath the frames so getch doesn't repaint it over them later
+			wnoutrefresh(stdscr);
 			
 			// Recalculate maximum number of visible textboxes
 			gcount_vis = (scrhei - 2) / (TEXTBOX_HEIGHT + 1);
 			// Move gcurs back to top
-			if(gcurs) gcurs->curs = NULL;  // Hide cursor
+			if(gcurs) gcurs->curs = CURS_HIDDEN;  // Hide cursor
 			gcurs = gtop;
-			if(gcurs) gcurs->curs = gcurs->text;
+			if(gcurs) gcurs->curs = 0;
 			gcurs_idx = 0;
 			
 			// On Resize both Graph and Gallery need to be redrawn
@@ -161,40 +242,45 @@ int main(int argc, char *argv[]){
 		// Graph Redrawing
 		// --------------------------
 		if(update_graph){
-			// Draw graph
-			wclear(grp.win);  // Clear graph window
+			trace_begin("frame", NULL);
+			double start = stats_enabled ? stats_now() : 0;
+			
+			// Compose graph in its frame so only the cells that changed are written
+			frame_erase(&graphfr);
 			draw_gridlines(grp);
 			
-			// Draw equations
-			for(equat_t eq = gallery; eq; eq = eq->next){
-				if(!(eq->is_variable) && eq->right){ // Only draw equation if it doesn't represent a variable
-					wattron(grp.win, COLOR_PAIR(eq->color_pair));
-					draw_curve(grp, eval_equat, eq);
-					wattroff(grp.win, COLOR_PAIR(eq->color_pair));
-				}
-			}
+			// Draw equations keeping their signs for the intersection search
+			draw_curves(grp, gallery, renderer, &grid);
 			
 			// Draw Intersections
 			if(intersections){
 				inter_t inr = intersections;
 				
 				// Display the coordinates of the selected point
-				int height, width;
-				getmaxyx(grp.win, height, width);
-				mvwprintw(grp.win, height - 1, 0, "(%.10lg, %.10lg)", inr->x, inr->y);
+				char label[64];
+				snprintf(label, sizeof(label), "(%.10lg, %.10lg)", inr->x, inr->y);
+				grp.tg->print(grp.tg, 0, grp.tg->rows - 1, label, 0);
 				
 				do{
 					// Check if inr should be highlighted (when its pointed to by intersections)
-					wattron(grp.win, COLOR_PAIR(inr == intersections ? ((equat_t)(inr->param2))->color_pair | INVERT_PAIR : ((equat_t)(inr->param1))->color_pair));
-					draw_point(grp, inr->x, inr->y, 'O');
-					wattroff(grp.win, COLOR_PAIR(inr == intersections ? ((equat_t)(inr->param2))->color_pair | INVERT_PAIR : ((equat_t)(inr->param1))->color_pair));
+					draw_point(grp, inr->x, inr->y, 'O', inr == intersections ? ((equat_t)(inr->param2))->color_pair | INVERT_PAIR : ((equat_t)(inr->param1))->color_pair);
 					
 					inr = inr->next;
 				}while(inr != intersections);
 				
 			}
 			
-			wrefresh(grp.win);
+			if(stats_enabled) stats_frame(stats_now() - start);
+			if(show_status){
+				// Counters include any work done since the line was last shown (e.g. finding intersections)
+				char status[160];
+				stats_status(status, sizeof(status), &status_stats, gallery);
+				grp.tg->print(grp.tg, 0, 0, status, 0);
+				status_stats = stats;
+			}
+			
+			frame_flush(&graphfr);
+			trace_end("frame");
 		}
 		
 		
@@ -202,10 +288,17 @@ int main(int argc, char *argv[]){
 		// -----------------------
 		if(update_gallery){
 			// Draw gallery
-			wclear(galwin);
+			frame_erase(&galfr);
 			// Draw equations starting from top 
-			draw_gallery(galwin, gtop, !focus_on_graph);
-			wrefresh(galwin);
+			draw_gallery(&galtg, gtop, !focus_on_graph);
+			frame_flush(&galfr);
+		}
+		
+		// Send both windows to the terminal at once
+		if(update_graph || update_gallery){
+			trace_begin("refresh", NULL);
+			doupdate();
+			trace_end("refresh");
 		}
 		
 		
@@ -228,54 +321,31 @@ int main(int argc, char *argv[]){
 				case 'Q': running = 0;
 				break;
 				
-				// Movement controls
-				case 'j':
-				case KEY_DOWN: grp.y -= grp.hei / 10;
-				break;
-				case 'k':
-				case KEY_UP: grp.y += grp.hei / 10;
-				break;
-				case 'h':
-				case KEY_LEFT: grp.x -= grp.wid / 10;
-				break;
-				case 'l':
-				case KEY_RIGHT: grp.x += grp.wid / 10;
-				break;
-				
-				// Dilation controls in each dimension
-				case 'J':
-				case KEY_SDOWN: zoom_graph(&grp, 1, 1.1);
-				break;
-				case 'K':
-				case KEY_SUP: zoom_graph(&grp, 1, 0.9);
-				break;
-				case 'H':
-				case KEY_SLEFT: zoom_graph(&grp, 1.1, 1);
-				break;
-				case 'L':
-				case KEY_SRIGHT: zoom_graph(&grp, 0.9, 1);
-				break;
-				
-				// Dilation controls for both dimensions
-				case '-': zoom_graph(&grp, 1.1, 1.1); // Zoom Out (-)
-				break;
-				case '=': zoom_graph(&grp, 0.9, 0.9); // Zoom In (+)
-				break;
-				case '0': setdims_graph(&grp, 10, 10); // Zoom Standard
-				break;
-				
 				// Intersection Controls
 				case 'n': // Generate Intersections
 				case 'N':
 				{
 					// Create bounding rectangle
-					struct bound_s rect = {grp.x, grp.y, grp.wid, grp.hei, 0, 0};
-					getmaxyx(grp.win, rect.rows, rect.columns);
+					struct bound_s rect = {.x = grp.x, .y = grp.y, .width = grp.wid, .height = grp.hei, .rows = grp.tg->rows, .columns = grp.tg->cols};
+					
+					// Signs left by drawing are approximate so the curves are sampled exactly once for all of their pairs
+					int count = 0;
+					for(equat_t eq = gallery; eq; eq = eq->next) if(!(eq->is_variable) && eq->right) count++;
+					equat_t *eqs = malloc((count > 0 ? count : 1) * sizeof(equat_t));
+					if(eqs){
+						count = 0;
+						for(equat_t eq = gallery; eq; eq = eq->next) if(!(eq->is_variable) && eq->right) eqs[count++] = eq;
+						sample_equats(&grid, rect, eqs, count);
+						free(eqs);
+					}
 					
 					// Iterate over all equations
 					for(equat_t eq1 = gallery; eq1; eq1 = eq1->next) if(!(eq1->is_variable) && eq1->right){
 						// Iterate over all equations after eq1
 						for(equat_t eq2 = eq1->next; eq2; eq2 = eq2->next) if(!(eq2->is_variable) && eq2->right){
+							// Reuse the signs sampled above
+							rect.signs1 = signgrid_find(&grid, rect, eq1);
+							rect.signs2 = signgrid_find(&grid, rect, eq2);
 							append_inters(
 								&intersections, rect,
 								eval_equat, eq1,
@@ -304,6 +374,21 @@ int main(int argc, char *argv[]){
 					}
 				break;
 				
+				// Switch between methods of drawing curves
+				case 'm':
+				case 'M':
+					renderer = (renderer + 1) % RENDER_COUNT;
+				break;
+				
+				// Show or hide the statistics of each redraw
+				case 's':
+				case 'S':
+					show_status = !show_status;
+					stats_enabled = show_status || args.show_stats;
+					// Redraw to show or clear the line
+					update_graph = 1;
+				break;
+				
 				// Switch focus to textboxes in gallery
 				case 'g':
 				case 'G':
@@ -311,6 +396,21 @@ int main(int argc, char *argv[]){
 					update_graph = 0;
 					update_gallery = 1;
 				break;
+				
+				// Movement and zoom controls
+				default:
+					if(view_key(&grp, c)){
+						// Drain keys already queued (e.g. by key auto-repeat) before redrawing
+						// Consecutive movements and zooms are folded into grp so only the final viewport is drawn
+						nodelay(stdscr, TRUE);
+						while((c2 = getch()) != ERR && view_key(&grp, c2)){}
+						// Leave the first key that isn't a movement or zoom for the next iteration
+						if(c2 != ERR) ungetch(c2);
+						nodelay(stdscr, FALSE);
+					}else{
+						update_graph = 0;
+					}
+				break;
 			}
 		}else{
 			// Gallery Controls
@@ -323,16 +423,16 @@ int main(int argc, char *argv[]){
 			if(gcurs){
 				switch(c){
 					case KEY_DOWN:
-						if(gcurs->curs >= gcurs->text){
+						if(gcurs->curs >= 0){
 							// If cursor is in text move it to the color picker
-							gcurs->curs = gcurs->text - 1;
+							gcurs->curs = CURS_PICKER;
 						}else{
 							if(gcurs->next){  // If cursor on color picker & there is a next textbox
 								// Hide cursor in gcurs
-								gcurs->curs = NULL;
+								gcurs->curs = CURS_HIDDEN;
 								// Move cursor down to next textbox
 								gcurs = gcurs->next;
-								gcurs->curs = gcurs->text;  // Put cursor in text
+								gcurs->curs = 0;  // Put cursor in text
 								gcurs_idx++;
 								
 								// Check if gcurs has gone below the visible range
@@ -345,13 +445,13 @@ int main(int argc, char *argv[]){
 						}
 					break;
 					case KEY_UP:
-						if(gcurs->curs >= gcurs->text){
+						if(gcurs->curs >= 0){
 							if(gcurs->prev){
 								// Hide cursor in gcurs
-								gcurs->curs = NULL;
+								gcurs->curs = CURS_HIDDEN;
 								// If cursor is in text move it to previous textbox
 								gcurs = gcurs->prev;
-								gcurs->curs = gcurs->text - 1;  // Put cursor on color picker
+								gcurs->curs = CURS_PICKER;  // Put cursor on color picker
 								gcurs_idx--;
 								
 								// Check if gcurs has gone above the visible range
@@ -362,13 +462,13 @@ int main(int argc, char *argv[]){
 							}
 						}else{
 							// If cursor on color picker move into text
-							gcurs->curs = gcurs->text;
+							gcurs->curs = 0;
 						}
 					break;
 					case KEY_RIGHT:
-						if(gcurs->curs >= gcurs->text){
+						if(gcurs->curs >= 0){
 							// Move text cursor within selected textbox
-							if(*(gcurs->curs) != '\0' && gcurs->curs < gcurs->text + TEXTBOX_SIZE)
+							if((size_t)gcurs->curs < equat_len(gcurs))
 								gcurs->curs++;
 						}else{
 							// Change color
@@ -380,8 +480,8 @@ int main(int argc, char *argv[]){
 						}
 					break;
 					case KEY_LEFT:
-						if(gcurs->curs >= gcurs->text){
-							if(gcurs->curs > gcurs->text)
+						if(gcurs->curs >= 0){
+							if(gcurs->curs > 0)
 								gcurs->curs--;
 						}else{
 							// Change color
@@ -396,24 +496,16 @@ int main(int argc, char *argv[]){
 					case KEY_BACKSPACE:
 					case 0x7f:
 					case '\b': // Backspace
-						if(gcurs->curs > gcurs->text){
-							// Move through text copying characters backwards
-							for(char *s = gcurs->curs - 1; *s != '\0' && s < gcurs->text + TEXTBOX_SIZE - 1; s++){
-								*s = *(s + 1);
-							}
-							// Move cursor backwards
-							gcurs->curs--;
-						}
+						// Remove character and move cursor backwards
+						if(gcurs->curs > 0) erase_equat_char(gcurs);
 					break;
 					case KEY_HOME:
 						// Move cursor to beginning of text
-						if(gcurs->curs >= gcurs->text) gcurs->curs = gcurs->text;
+						if(gcurs->curs >= 0) gcurs->curs = 0;
 					break;
 					case KEY_END:
 						// Move cursor to end of text
-						if(gcurs->curs >= gcurs->text){
-							gcurs->curs = gcurs->text + expr_strnlen(gcurs->text, TEXTBOX_SIZE);
-						}
+						if(gcurs->curs >= 0) gcurs->curs = equat_len(gcurs);
 					break;
 					
 					// Parse text in textbox to update equation
@@ -421,8 +513,10 @@ int main(int argc, char *argv[]){
 					case '\r':
 					case '\n':
 						// If in textbox parse text
-						if(gcurs->curs >= gcurs->text){
+						if(gcurs->curs >= 0){
 							parse_equat(gallery, gcurs);
+							// Reparsing drops the native code of the equation and those using it
+							if(args.compile) compile_equats(gallery);
 							
 							// Update graph to reflect new equation
 							update_graph = 1;
@@ -431,16 +525,7 @@ int main(int argc, char *argv[]){
 					
 					// Remove current textbox and equation
 					case 'D' & 0x1f:
-						if(gcurs->prev){
-							// If gcurs is not at head then connect linked before and after gcurs
-							gcurs->prev->next = gcurs->next;
-							if(gcurs->next) gcurs->next->prev = gcurs->prev;
-						}else{
-							// If gcurs at head then point gallery to next element
-							gallery = gcurs->next;
-							if(gcurs->next) gcurs->next->prev = NULL;
-						}
-						
+					{
 						// Remove intersections attached to equation
 						bool remd;
 						do{
@@ -452,12 +537,12 @@ int main(int argc, char *argv[]){
 						if(gcurs->prev){
 							ngcurs = gcurs->prev;
 							gcurs_idx--;
-						}else ngcurs = gallery;
+						}else ngcurs = gcurs->next;
+						if(gtop == gcurs) gtop = ngcurs;
 						
-						// Deallocate memory for equation
-						if(!(gcurs->is_variable) && gcurs->left) free(gcurs->left);
-						if(gcurs->right) free(gcurs->right);
-						free(gcurs);
+						// Unlink equation, reparse the equations using it, and deallocate it
+						remove_equat(&gallery, gcurs);
+						if(args.compile) compile_equats(gallery);
 						
 						// Move cursor up
 						gcurs = ngcurs;
@@ -465,31 +550,17 @@ int main(int argc, char *argv[]){
 							gtop = gcurs;
 							gcurs_idx = 0;
 						}
-						if(gcurs) gcurs->curs = gcurs->text;  // Put cursor in text
+						if(gcurs) gcurs->curs = 0;  // Put cursor in text
 						
 						// Update graph to remove the curve for this equation
 						update_graph = 1;
+					}
 					break;
 				}
 				
 				// If c can be printed then place it in the text
-				if(isprint(c) && gcurs->curs){
-					char tmp, *s;
-					for(s = gcurs->curs; s < gcurs->text + TEXTBOX_SIZE; s++){
-						tmp = c;
-						c = *s;
-						*s = tmp;
-						
-						// If all characters up to the null have been moved end
-						if(*s == '\0') break;
-					}
-					
-					// Move cursor forward
-					if(gcurs->curs < gcurs->text + TEXTBOX_SIZE - 1) gcurs->curs++;
-					
-					// Ensure text is null terminated
-					gcurs->text[TEXTBOX_SIZE - 1] = '\0';
-				}
+				// The text grows as needed so there is no limit on its length
+				if(isprint(c) && gcurs->curs >= 0) insert_equat_char(gcurs, c);
 			}
 			
 			// Perform regardless of if cursor is present
@@ -501,7 +572,7 @@ int main(int argc, char *argv[]){
 		
 		// Command runs for both modes
 		if(c == (int)('A' & 0x1f)){ // ^A, Ctrl-A
-			if(gcurs) gcurs->curs = NULL;  // Hide old cursor
+			if(gcurs) gcurs->curs = CURS_HIDDEN;  // Hide old cursor
 			
 			// Create new textbox (not necessary for gcurs != NULL)
 			// Create equation and textbox at end of gallery and move cursor to it
@@ -519,8 +590,13 @@ int main(int argc, char *argv[]){
 		}
 	}
 	
-	delwin(grp.win);
+	frame_free(&graphfr);
+	frame_free(&galfr);
+	delwin(graphwin);
+	delwin(galwin);
 	endwin();
+	
+	if(args.show_stats) stats_report(stderr, gallery);
 	return 0;
 }
 
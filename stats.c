@@ -0,0 +1,89 @@
+#include <time.h>
+
+#include "stats.h"
+#include "gallery.h"
+
+stats_t stats = {.frames = 0};
+bool stats_enabled = 0;
+
+
+
+double stats_now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+unsigned long stats_evals(const stats_t *st){
+	unsigned long total = 0;
+	for(int i = 0; i < EXPR_TYPE_COUNT; i++) total += st->evals[i];
+	return total;
+}
+
+void stats_frame(double secs){
+	stats.frames++;
+	stats.frame_total += secs;
+	stats.frame_last = secs;
+	if(secs > stats.frame_max) stats.frame_max = secs;
+}
+
+
+
+// Write v with a suffix for thousands or millions so it stays short
+static void put_count(char *buf, size_t n, unsigned long v){
+	if(v >= 10000000) snprintf(buf, n, "%luM", v / 1000000);
+	else if(v >= 10000) snprintf(buf, n, "%luk", v / 1000);
+	else snprintf(buf, n, "%lu", v);
+}
+
+void stats_status(char *buf, size_t n, const stats_t *prev, equat_t gallery){
+	char evals[16], points[16];
+	put_count(evals, sizeof(evals), stats_evals(&stats) - stats_evals(prev));
+	put_count(points, sizeof(points), stats.check_points - prev->check_points);
+	
+	// Curve whose last redraw took the longest numbered by its textbox
+	int idx = 0, slow_idx = 0;
+	double slow = 0;
+	for(equat_t eq = gallery; eq; eq = eq->next){
+		idx++;
+		if(!(eq->is_variable) && eq->draw_time > slow){
+			slow = eq->draw_time;
+			slow_idx = idx;
+		}
+	}
+	
+	int len = snprintf(buf, n, "frame %.1fms  evals %s  points %s  isolate %lu/%lu d%d",
+		1e3 * stats.frame_last, evals, points,
+		stats.isolates - prev->isolates, stats.isolate_branches - prev->isolate_branches, stats.isolate_depth
+	);
+	if(slow_idx && len >= 0 && (size_t)len < n){
+		snprintf(buf + len, n - len, "  slowest #%d %.1fms", slow_idx, 1e3 * slow);
+	}
+}
+
+void stats_report(FILE *fp, equat_t gallery){
+	fprintf(fp, "Statistics:\n");
+	if(stats.frames){
+		fprintf(fp, "  %-24s %lu (avg %.2f ms, max %.2f ms)\n", "redraws", stats.frames,
+			1e3 * stats.frame_total / stats.frames, 1e3 * stats.frame_max
+		);
+	}
+	
+	fprintf(fp, "  %-24s %lu\n", "eval_expr calls", stats_evals(&stats));
+	for(int i = 0; i < EXPR_TYPE_COUNT; i++){
+		if(stats.evals[i]) fprintf(fp, "    %-22s %lu\n", expr_type_names[i], stats.evals[i]);
+	}
+	fprintf(fp, "  %-24s %lu\n", "check_point calls", stats.check_points);
+	fprintf(fp, "  %-24s %lu\n", "isolate_inter calls", stats.isolates);
+	fprintf(fp, "  %-24s %lu\n", "isolate_inter branches", stats.isolate_branches);
+	fprintf(fp, "  %-24s %d\n", "isolate_inter depth", stats.isolate_depth);
+	
+	// Time of each curve numbered by its textbox
+	fprintf(fp, "Curves (ms drawing or sampling in the last pass, ms in total):\n");
+	int idx = 0;
+	for(equat_t eq = gallery; eq; eq = eq->next){
+		idx++;
+		if(eq->is_variable || !(eq->right)) continue;
+		fprintf(fp, "  #%-3d %10.2f %10.2f  %s\n", idx, 1e3 * eq->draw_time, 1e3 * eq->draw_total, equat_text(eq));
+	}
+}
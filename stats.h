@@ -0,0 +1,51 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "expr.h"
+
+// Equations of a gallery (see gallery.h)
+struct equat_s;
+
+/* Counters of the work done by the hot paths of the engine
+ * The counters are always incremented since they only cost an add each,
+ * while the clocks used for the draw and frame times are only read when stats_enabled is set
+ */
+typedef struct{
+	// Calls to eval_expr for each type of node
+	unsigned long evals[EXPR_TYPE_COUNT];
+	// Calls to check_point which evaluates both curves at a point for the intersection search
+	unsigned long check_points;
+	// Calls to isolate_inter, the number of times a triangle held both curves in several
+	// of its sub-triangles so the search branched, and the deepest nesting of the calls
+	unsigned long isolates, isolate_branches;
+	int isolate_depth;
+	
+	// Number of redraws of the graph and the seconds taken by all of them, the last, and the slowest
+	unsigned long frames;
+	double frame_total, frame_last, frame_max;
+} stats_t;
+
+// Counters since the program started
+extern stats_t stats;
+// Whether draw and frame times are measured
+extern bool stats_enabled;
+
+// Seconds since an arbitrary point used for measuring durations
+double stats_now(void);
+// Total calls to eval_expr counted in st
+unsigned long stats_evals(const stats_t *st);
+// Record a redraw of the graph taking secs seconds
+void stats_frame(double secs);
+
+// Write a single line summary of the last redraw into buf of n bytes
+// The counters are those accumulated since prev (a copy of stats taken before the redraw)
+// along with the curve of gallery which took the longest to draw
+void stats_status(char *buf, size_t n, const stats_t *prev, struct equat_s *gallery);
+// Write a report of every counter and the time spent drawing each curve of gallery to fp
+void stats_report(FILE *fp, struct equat_s *gallery);
+
+#endif
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "symtab.h"
+
+// Number of buckets of a new table
+#define SYMTAB_MIN_BUCKETS 64
+
+// Check if entry has the name given by the n characters of name and its hash
+#define sym_matches(s, h, str, n) ((s)->hash == (h) && (s)->len == (n) && memcmp((s)->name, (str), (n)) == 0)
+
+unsigned long symtab_hash(const char *name, size_t n){
+	// FNV-1a
+	unsigned long hash = 2166136261ul;
+	for(size_t i = 0; i < n; i++){
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619ul;
+	}
+	return hash;
+}
+
+// Double the number of buckets and move the entries into them
+static bool symtab_grow(symtab_t *tab){
+	size_t nbuckets = tab->nbuckets ? 2 * tab->nbuckets : SYMTAB_MIN_BUCKETS;
+	struct sym_s **buckets = calloc(nbuckets, sizeof(struct sym_s*));
+	if(!buckets) return 0;
+	
+	// Move entries keeping those with the same name in order
+	for(size_t i = 0; i < tab->nbuckets; i++){
+		struct sym_s *sym = tab->buckets[i], *next;
+		for(; sym; sym = next){
+			next = sym->next;
+			
+			struct sym_s **end = buckets + sym->hash % nbuckets;
+			while(*end) end = &((*end)->next);
+			*end = sym;
+			sym->next = NULL;
+		}
+	}
+	
+	free(tab->buckets);
+	tab->buckets = buckets;
+	tab->nbuckets = nbuckets;
+	return 1;
+}
+
+struct sym_s *symtab_add(symtab_t *tab, const char *name, size_t n, void *value){
+	// Keep an average of at most one entry per bucket
+	if(tab->count >= tab->nbuckets && !symtab_grow(tab)) return NULL;
+	
+	struct sym_s *sym = malloc(sizeof(struct sym_s));
+	if(!sym) return NULL;
+	sym->name = malloc(n + 1);
+	if(!(sym->name)){
+		free(sym);
+		return NULL;
+	}
+	memcpy(sym->name, name, n);
+	sym->name[n] = '\0';
+	sym->len = n;
+	sym->hash = symtab_hash(name, n);
+	sym->value = value;
+	sym->next = NULL;
+	
+	// Append to the bucket so entries with the same name are found in the order they were added
+	struct sym_s **end = tab->buckets + sym->hash % tab->nbuckets;
+	while(*end) end = &((*end)->next);
+	*end = sym;
+	
+	tab->count++;
+	return sym;
+}
+
+void symtab_remove(symtab_t *tab, struct sym_s *sym){
+	struct sym_s **link = tab->buckets + sym->hash % tab->nbuckets;
+	while(*link && *link != sym) link = &((*link)->next);
+	if(!(*link)) return;
+	
+	*link = sym->next;
+	free(sym->name);
+	free(sym);
+	tab->count--;
+}
+
+struct sym_s *symtab_find(const symtab_t *tab, const char *name, size_t n){
+	if(tab->nbuckets == 0) return NULL;
+	
+	unsigned long hash = symtab_hash(name, n);
+	for(struct sym_s *sym = tab->buckets[hash % tab->nbuckets]; sym; sym = sym->next){
+		if(sym_matches(sym, hash, name, n)) return sym;
+	}
+	return NULL;
+}
+
+struct sym_s *symtab_next(const struct sym_s *sym){
+	for(struct sym_s *next = sym->next; next; next = next->next){
+		if(sym_matches(next, sym->hash, sym->name, sym->len)) return next;
+	}
+	return NULL;
+}
+
+void symtab_free(symtab_t *tab){
+	for(size_t i = 0; i < tab->nbuckets; i++){
+		struct sym_s *sym = tab->buckets[i], *next;
+		for(; sym; sym = next){
+			next = sym->next;
+			free(sym->name);
+			free(sym);
+		}
+	}
+	free(tab->buckets);
+	tab->buckets = NULL;
+	tab->nbuckets = 0;
+	tab->count = 0;
+}
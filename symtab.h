@@ -0,0 +1,46 @@
+#ifndef _SYMTAB_H
+#define _SYMTAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Entry of a symbol table
+struct sym_s{
+	// Copy of the name owned by the table
+	char *name;
+	size_t len;
+	unsigned long hash;
+	
+	// Value attached to the name
+	void *value;
+	
+	// Next entry in the same bucket
+	struct sym_s *next;
+};
+
+/* Hash table mapping names to values
+ * Names are matched exactly (same length and characters) and several entries may share a name
+ * Entries with the same name are found in the order they were added
+ */
+typedef struct{
+	struct sym_s **buckets;
+	size_t nbuckets, count;
+} symtab_t;
+
+// Hash the n characters of name
+unsigned long symtab_hash(const char *name, size_t n);
+
+// Add value under the first n characters of name
+// Returns the new entry or NULL if memory could not be allocated
+struct sym_s *symtab_add(symtab_t *tab, const char *name, size_t n, void *value);
+// Remove and deallocate an entry returned by symtab_add
+void symtab_remove(symtab_t *tab, struct sym_s *sym);
+// Find the first entry whose name is the n characters of name
+// Returns NULL if there is none
+struct sym_s *symtab_find(const symtab_t *tab, const char *name, size_t n);
+// Find the entry after sym with the same name
+struct sym_s *symtab_next(const struct sym_s *sym);
+// Deallocate every entry of tab
+void symtab_free(symtab_t *tab);
+
+#endif
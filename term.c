@@ -0,0 +1,105 @@
+#include <stdlib.h>
+
+#include "term.h"
+
+// Place character in frame when (x, y) is within its bounds
+static void frame_put(target_t *tg, int x, int y, int ch, int color){
+	if(x < 0 || x >= tg->cols || y < 0 || y >= tg->rows) return;
+	
+	frame_t *fr = tg->data;
+	struct cell_s *cell = fr->cells + (size_t)y * fr->cols + x;
+	cell->ch = ch;
+	cell->color = color;
+}
+
+// Print string into frame starting at (x, y) and cut it off at the edge
+static void frame_print(target_t *tg, int x, int y, const char *str, int color){
+	if(y < 0 || y >= tg->rows) return;
+	for(; *str && x < tg->cols; str++, x++) frame_put(tg, x, y, (unsigned char)*str, color);
+}
+
+bool frame_target(target_t *tg, frame_t *fr, WINDOW *win){
+	int cols, rows;
+	getmaxyx(win, rows, cols);
+	
+	size_t size = (size_t)rows * cols;
+	struct cell_s *cells = realloc(fr->cells, size * sizeof(struct cell_s));
+	if(!cells && size) return 0;
+	fr->cells = cells;
+	struct cell_s *shown = realloc(fr->shown, size * sizeof(struct cell_s));
+	if(!shown && size) return 0;
+	fr->shown = shown;
+	
+	fr->win = win;
+	fr->cols = cols;
+	fr->rows = rows;
+	
+	// Contents of the window and terminal are unknown so every cell must be written on the next flush
+	for(size_t i = 0; i < size; i++) fr->shown[i].ch = -1;
+	clearok(win, TRUE);
+	frame_erase(fr);
+	
+	tg->cols = cols;
+	tg->rows = rows;
+	tg->put = frame_put;
+	tg->print = frame_print;
+	tg->data = fr;
+	return 1;
+}
+
+void frame_free(frame_t *fr){
+	free(fr->cells);
+	free(fr->shown);
+	fr->cells = NULL;
+	fr->shown = NULL;
+	fr->cols = 0;
+	fr->rows = 0;
+}
+
+void frame_erase(frame_t *fr){
+	size_t size = (size_t)fr->rows * fr->cols;
+	for(size_t i = 0; i < size; i++){
+		fr->cells[i].ch = ' ';
+		fr->cells[i].color = 0;
+	}
+}
+
+void frame_flush(frame_t *fr){
+	// Run of changed ASCII cells waiting to be written
+	chtype run[fr->cols > 0 ? fr->cols : 1];
+	
+	for(int y = 0; y < fr->rows; y++){
+		struct cell_s *cells = fr->cells + (size_t)y * fr->cols;
+		struct cell_s *shown = fr->shown + (size_t)y * fr->cols;
+		
+		int start = 0, len = 0;
+		for(int x = 0; x <= fr->cols; x++){
+			bool changed = x < fr->cols && (cells[x].ch != shown[x].ch || cells[x].color != shown[x].color);
+			
+			if(changed && cells[x].ch < 0x80){
+				// Extend the run with the cell
+				if(len == 0) start = x;
+				run[len++] = (chtype)cells[x].ch | COLOR_PAIR(cells[x].color);
+				continue;
+			}
+			
+			// Write run once it is broken by an unchanged or wide cell
+			if(len > 0){
+				mvwaddchnstr(fr->win, y, start, run, len);
+				len = 0;
+			}
+			
+			if(changed){
+				// Characters outside of ASCII (i.e. Braille) must be added as wide characters
+				wchar_t wch[2] = {cells[x].ch, L'\0'};
+				cchar_t cch;
+				setcchar(&cch, wch, A_NORMAL, cells[x].color, NULL);
+				mvwadd_wch(fr->win, y, x, &cch);
+			}
+		}
+		
+		for(int x = 0; x < fr->cols; x++) shown[x] = cells[x];
+	}
+	
+	wnoutrefresh(fr->win);
+}
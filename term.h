@@ -0,0 +1,39 @@
+#ifndef _TERM_H
+#define _TERM_H
+
+// Wide character functions are needed to draw Braille characters
+#define NCURSES_WIDECHAR 1
+#include <ncurses.h>
+
+#include "graph.h"
+
+// Character and color pair of a cell in a frame
+struct cell_s{
+	int ch, color;
+};
+
+/* Frame composed in memory before being written to an ncurses window
+ * Only the cells which differ from the last frame written are sent to the window
+ * so redrawing a frame which barely changed sends little to the terminal
+ */
+typedef struct{
+	WINDOW *win;
+	int cols, rows;
+	
+	// Cells of the frame being composed and of the frame last written to win
+	struct cell_s *cells, *shown;
+} frame_t;
+
+// Initialize fr to compose frames for win and tg to draw into fr
+// Must be called again after win is resized to update the dimensions of fr and tg
+// Returns false if the memory for the cells could not be allocated
+bool frame_target(target_t *tg, frame_t *fr, WINDOW *win);
+// Deallocate the cells of fr
+void frame_free(frame_t *fr);
+// Blank every cell of fr to start composing a new frame
+void frame_erase(frame_t *fr);
+// Write the cells of fr which changed since the last flush to its window
+// The window is staged with wnoutrefresh so doupdate() must be called to update the terminal
+void frame_flush(frame_t *fr);
+
+#endif
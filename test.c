@@ -0,0 +1,172 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gallery.h"
+
+// Regression tests of the engine run by make test
+// Each test prints a line for every failed check and the program exits with the number of failures
+
+static int failures = 0;
+
+#define CHECK(cond) check(cond, #cond, __func__, __LINE__)
+static void check(bool cond, const char *text, const char *test, int line){
+	if(cond) return;
+	printf("%s:%d: check failed: %s\n", test, line, text);
+	failures++;
+}
+
+// Add each equation of texts to gallery and parse it before adding the next like the textboxes do
+static void enter_equats(equat_t *gallery, equat_t *eqs, const char **texts, int count){
+	for(int i = 0; i < count; i++){
+		eqs[i] = add_equat(gallery, texts[i]);
+		parse_equat(*gallery, eqs[i]);
+	}
+}
+
+static void free_gallery(equat_t *gallery){
+	while(*gallery) remove_equat(gallery, *gallery);
+}
+
+
+// Variables referenced before they are defined resolve once they are
+// even when the variable they reference is only parsed later in the same pass
+static void test_late_definition(void){
+	const char *texts[] = {"g := a + h", "h := a * 2", "a := 1", "y = g"};
+	equat_t gallery = NULL, eqs[4];
+	enter_equats(&gallery, eqs, texts, 4);
+	
+	for(int i = 0; i < 4; i++) CHECK(eqs[i]->err == ERR_OK);
+	if(eqs[3]->err == ERR_OK) CHECK(eval_equat(eqs[3], 0, 3) == 0);
+	free_gallery(&gallery);
+	
+	// The same with the equation referencing g entered before it resolves
+	const char *early[] = {"g := a + h", "y = g", "h := a * 2", "a := 1"};
+	enter_equats(&gallery, eqs, early, 4);
+	for(int i = 0; i < 4; i++) CHECK(eqs[i]->err == ERR_OK);
+	free_gallery(&gallery);
+}
+
+// Variables referencing each other are circular regardless of the order they are entered in
+static void test_mutual_cycle(void){
+	const char *texts[] = {"p := q", "q := p", "p = y"};
+	equat_t gallery = NULL, eqs[3];
+	enter_equats(&gallery, eqs, texts, 3);
+	
+	CHECK(eqs[0]->err == ERR_CIRCULAR);
+	CHECK(eqs[1]->err == ERR_CIRCULAR);
+	CHECK(eqs[2]->err == ERR_CIRCULAR);
+	
+	// Breaking the cycle resolves both
+	set_equat_text(eqs[0], "p := 2");
+	parse_equat(gallery, eqs[0]);
+	for(int i = 0; i < 3; i++) CHECK(eqs[i]->err == ERR_OK);
+	free_gallery(&gallery);
+}
+
+// Renaming or removing a variable leaves its references unrecognized until the name is defined again
+static void test_rename_and_remove(void){
+	const char *texts[] = {"a := 1", "y = a", "b := a + 1"};
+	equat_t gallery = NULL, eqs[3];
+	enter_equats(&gallery, eqs, texts, 3);
+	
+	set_equat_text(eqs[0], "c := 1");
+	parse_equat(gallery, eqs[0]);
+	CHECK(eqs[1]->err == ERR_UNRECOGNIZED_NAME);
+	CHECK(eqs[2]->err == ERR_UNRECOGNIZED_NAME);
+	
+	set_equat_text(eqs[0], "a := 2");
+	parse_equat(gallery, eqs[0]);
+	CHECK(eqs[1]->err == ERR_OK && eval_equat(eqs[1], 0, 2) == 0);
+	CHECK(eqs[2]->err == ERR_OK);
+	
+	remove_equat(&gallery, eqs[0]);
+	CHECK(eqs[1]->err == ERR_UNRECOGNIZED_NAME);
+	CHECK(eqs[2]->err == ERR_UNRECOGNIZED_NAME);
+	free_gallery(&gallery);
+}
+
+// Folding constants keeps the sign of zero sums which atan2 and division tell apart
+static void test_fold_negative_zero(void){
+	// The parser only takes a leading minus at the start of an argument so the -1 is written as 0 - 1
+	const char *texts[] = {"y = atan2(-0 - 0, 0 - 1)", "y = 1 / (-0 - 0)", "y = 1 / (x + 0)"};
+	double values[] = {atan2(-0.0, -1), -INFINITY, INFINITY};
+	equat_t gallery = NULL, eqs[3];
+	enter_equats(&gallery, eqs, texts, 3);
+	
+	// Evaluated at y = 0 (and x = +0) the equations are 0 - value
+	for(int i = 0; i < 3; i++) CHECK(eqs[i]->err == ERR_OK && eval_equat(eqs[i], 0, 0) == -values[i]);
+	free_gallery(&gallery);
+}
+
+// Constants after other terms aren't moved ahead of them which would round the sum differently
+static void test_fold_in_order(void){
+	// Folding the 1 first gives (1 + x^2) - x^2 which isn't exactly 1 so the power of a negative base is NaN
+	const char *texts[] = {"f(u) := u^2 - x*u + 1", "y = x^(f(x))"};
+	equat_t gallery = NULL, eqs[2];
+	enter_equats(&gallery, eqs, texts, 2);
+	
+	CHECK(eqs[1]->err == ERR_OK && eval_equat(eqs[1], -1.33, 0) == 1.33);
+	free_gallery(&gallery);
+}
+
+// Deeply nested expressions are rejected instead of overflowing the stack while they are rewritten and evaluated
+static void test_deep_nesting(void){
+	int levels = 100000;
+	char *text = malloc(2 * levels + 8), *end = text + sprintf(text, "y = ");
+	for(int i = 0; i < levels; i++) end += sprintf(end, "x^");
+	sprintf(end, "1");
+	
+	const char *texts[] = {text, "y = x^x^x^x^x^x^x^x^1"};
+	equat_t gallery = NULL, eqs[2];
+	enter_equats(&gallery, eqs, texts, 2);
+	CHECK(eqs[0]->err == ERR_TOO_DEEP);
+	CHECK(eqs[1]->err == ERR_OK);
+	free_gallery(&gallery);
+	free(text);
+}
+
+// Cells drawn onto the target of test_trace_small_loop
+#define CELLS_W 80
+#define CELLS_H 40
+static char cells[CELLS_H][CELLS_W];
+
+static void put_test_cell(target_t *tg, int x, int y, int ch, int color){
+	(void)tg;
+	(void)color;
+	if(x >= 0 && x < CELLS_W && y >= 0 && y < CELLS_H) cells[y][x] = ch;
+}
+
+// Tracing draws loops which fit between the lines of its coarse grid like scanning every cell does
+static void test_trace_small_loop(void){
+	const char *texts[] = {"(x - 3.3)^2 + (y - 1.3)^2 = 0.3"};
+	equat_t gallery = NULL, eqs[1];
+	enter_equats(&gallery, eqs, texts, 1);
+	
+	target_t tg = {.cols = CELLS_W, .rows = CELLS_H, .put = put_test_cell};
+	graph_t gr = {.tg = &tg, .x = -10, .y = 10, .wid = 20, .hei = 20};
+	char traced[CELLS_H][CELLS_W];
+	memset(cells, ' ', sizeof(cells));
+	trace_curve(gr, eval_equat, eqs[0], 1);
+	memcpy(traced, cells, sizeof(cells));
+	memset(cells, ' ', sizeof(cells));
+	draw_curve(gr, eval_equat, eqs[0], 1);
+	
+	CHECK(memcmp(traced, cells, sizeof(cells)) == 0);
+	free_gallery(&gallery);
+}
+
+int main(){
+	test_late_definition();
+	test_mutual_cycle();
+	test_rename_and_remove();
+	test_fold_negative_zero();
+	test_fold_in_order();
+	test_deep_nesting();
+	test_trace_small_loop();
+	
+	if(failures) printf("%d checks failed\n", failures);
+	else printf("All checks passed\n");
+	return failures != 0;
+}
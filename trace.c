@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "trace.h"
+
+// Span beginning or ending
+struct trace_event_s{
+	const char *name;
+	// Microseconds since tracing started
+	double ts;
+	// 'B' for the beginning of a span or 'E' for its end
+	char phase;
+	char detail[TRACE_DETAIL_SIZE];
+};
+
+// Events recorded by one thread
+// Only the thread that owns a buffer writes to it so recording needs no locks
+struct trace_buffer_s{
+	struct trace_event_s events[TRACE_BUFFER_EVENTS];
+	int count;
+	
+	// Earlier full buffer of the same thread
+	struct trace_buffer_s *prev;
+};
+
+// Thread which has recorded events
+struct trace_thread_s{
+	int tid;
+	// Buffer being recorded into, only changed by the thread itself
+	struct trace_buffer_s *latest;
+	
+	// Next thread in the list of every thread
+	struct trace_thread_s *next;
+};
+
+bool trace_enabled = 0;
+
+// File the events are written to
+static FILE *trace_file = NULL;
+// Time tracing started in seconds
+static double trace_epoch;
+
+// List of every thread which has recorded events
+// Threads push themselves with compare and swap when they first record so none ever wait on another
+static _Atomic(struct trace_thread_s*) threads = NULL;
+static atomic_int thread_count = 0;
+// Entry of the calling thread in threads
+static _Thread_local struct trace_thread_s *local = NULL;
+
+
+
+static double trace_now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool trace_start(const char *path){
+	if(trace_file) return 1;
+	
+	trace_file = fopen(path, "w");
+	if(!trace_file) return 0;
+	
+	trace_epoch = trace_now();
+	trace_enabled = 1;
+	atexit(trace_stop);
+	return 1;
+}
+
+// Get a buffer of the calling thread with room for another event
+// Returns NULL if memory could not be allocated
+static struct trace_buffer_s *trace_buffer(void){
+	if(!local){
+		struct trace_thread_s *th = malloc(sizeof(struct trace_thread_s));
+		if(!th) return NULL;
+		th->tid = atomic_fetch_add(&thread_count, 1) + 1;
+		th->latest = NULL;
+		th->next = atomic_load(&threads);
+		while(!atomic_compare_exchange_weak(&threads, &(th->next), th)){}
+		local = th;
+	}
+	if(local->latest && local->latest->count < TRACE_BUFFER_EVENTS) return local->latest;
+	
+	// Start a new buffer after the full one
+	struct trace_buffer_s *buf = malloc(sizeof(struct trace_buffer_s));
+	if(!buf) return NULL;
+	buf->count = 0;
+	buf->prev = local->latest;
+	local->latest = buf;
+	return buf;
+}
+
+static void trace_event(const char *name, const char *detail, char phase){
+	if(!trace_enabled) return;
+	
+	struct trace_buffer_s *buf = trace_buffer();
+	if(!buf) return;
+	
+	struct trace_event_s *ev = buf->events + buf->count;
+	ev->name = name;
+	ev->ts = (trace_now() - trace_epoch) * 1e6;
+	ev->phase = phase;
+	ev->detail[0] = '\0';
+	if(detail){
+		strncpy(ev->detail, detail, TRACE_DETAIL_SIZE - 1);
+		ev->detail[TRACE_DETAIL_SIZE - 1] = '\0';
+	}
+	buf->count++;
+}
+
+void trace_begin(const char *name, const char *detail){
+	trace_event(name, detail, 'B');
+}
+
+void trace_end(const char *name){
+	trace_event(name, NULL, 'E');
+}
+
+
+
+// Write str as the contents of a JSON string
+static void write_escaped(FILE *fp, const char *str){
+	for(; *str; str++){
+		if(*str == '"' || *str == '\\') fprintf(fp, "\\%c", *str);
+		else if((unsigned char)*str < 0x20) fprintf(fp, "\\u%04x", *str);
+		else fputc(*str, fp);
+	}
+}
+
+// Write the events of buf and the earlier buffers of its thread in the order they were recorded
+static void write_buffer(FILE *fp, const struct trace_buffer_s *buf, long pid, int tid, bool *first){
+	if(!buf) return;
+	write_buffer(fp, buf->prev, pid, tid, first);
+	
+	for(int i = 0; i < buf->count; i++){
+		const struct trace_event_s *ev = buf->events + i;
+		fprintf(fp, "%s\n{\"name\":\"", *first ? "" : ",");
+		write_escaped(fp, ev->name);
+		fprintf(fp, "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%ld,\"tid\":%d", ev->phase, ev->ts, pid, tid);
+		if(ev->detail[0]){
+			fprintf(fp, ",\"args\":{\"detail\":\"");
+			write_escaped(fp, ev->detail);
+			fprintf(fp, "\"}");
+		}
+		fprintf(fp, "}");
+		*first = 0;
+	}
+}
+
+void trace_stop(void){
+	if(!trace_file) return;
+	trace_enabled = 0;
+	
+	long pid = (long)getpid();
+	bool first = 1;
+	fprintf(trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for(struct trace_thread_s *th = atomic_load(&threads); th; th = th->next){
+		write_buffer(trace_file, th->latest, pid, th->tid, &first);
+	}
+	fprintf(trace_file, "\n]}\n");
+	fclose(trace_file);
+	trace_file = NULL;
+	
+	// Only the buffers of the calling thread are freed since other threads could still be recording
+	if(local){
+		for(struct trace_buffer_s *buf = local->latest, *prev; buf; buf = prev){
+			prev = buf->prev;
+			free(buf);
+		}
+		local->latest = NULL;
+	}
+}
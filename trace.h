@@ -0,0 +1,40 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdbool.h>
+
+/* Tracer recording when spans of work begin and end for chrome://tracing or Perfetto
+ * Events are kept in memory and written as trace-event JSON when the program exits
+ *
+ * Usage:
+ *   trace_start("skedia.trace.json");
+ *   trace_begin("parse_equat", text);
+ *   ...
+ *   trace_end("parse_equat");
+ *
+ * Each thread records into its own buffers so no locks are taken,
+ * and every function returns immediately while tracing hasn't been started
+ */
+
+// Number of events in each buffer of a thread
+#define TRACE_BUFFER_EVENTS 4096
+// Longest detail kept with an event including the null (longer ones are cut off)
+#define TRACE_DETAIL_SIZE 48
+
+// Whether events are being recorded
+extern bool trace_enabled;
+
+// Start recording events which are written to path at exit
+// Returns false if the file could not be created
+bool trace_start(const char *path);
+// Write the events recorded so far and stop recording
+// Called at exit by trace_start
+void trace_stop(void);
+
+// Record the beginning of the span name with an optional detail shown with it (e.g. the text of an equation)
+// name must stay valid until the events are written (e.g. a string literal)
+void trace_begin(const char *name, const char *detail);
+// Record the end of the span name begun last by this thread
+void trace_end(const char *name);
+
+#endif